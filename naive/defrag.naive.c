@@ -0,0 +1,117 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <ftw.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/types.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+
+/* 与内核naivefs.h一致 */
+struct naive_defrag_range {
+    __u64 start;
+    __u64 len;
+    __u64 moved;
+};
+
+#define NAIVE_IOC_DEFRAG _IOWR('N', 1, struct naive_defrag_range)
+
+static int verbose;
+static unsigned long long total_moved;
+static int failed;
+
+/* 用FIEMAP统计文件的物理段数，失败时返回-1 */
+static long count_extents(int fd)
+{
+    struct fiemap fm;
+    
+    memset(&fm, 0, sizeof(fm));
+    fm.fm_length = FIEMAP_MAX_OFFSET;
+    fm.fm_extent_count = 0;     /* 只要段数 */
+    if (ioctl(fd, FS_IOC_FIEMAP, &fm) < 0)
+        return -1;
+    return fm.fm_mapped_extents;
+}
+
+static int defrag_file(const char *path)
+{
+    struct naive_defrag_range range;
+    long before, after;
+    int fd;
+    
+    fd = open(path, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        failed = 1;
+        return 0;
+    }
+    
+    before = count_extents(fd);
+    memset(&range, 0, sizeof(range));
+    range.len = ~0ULL;
+    if (ioctl(fd, NAIVE_IOC_DEFRAG, &range) < 0) {
+        fprintf(stderr, "%s: defrag failed: %s\n", path, strerror(errno));
+        failed = 1;
+        close(fd);
+        return 0;
+    }
+    after = count_extents(fd);
+    close(fd);
+    
+    total_moved += range.moved;
+    if (verbose || range.moved)
+        printf("%s: %ld -> %ld extents, %llu blocks moved\n",
+               path, before, after, (unsigned long long)range.moved);
+    return 0;
+}
+
+static int walk(const char *path, const struct stat *st, int type,
+                struct FTW *ftw __attribute__((unused)))
+{
+    if (type == FTW_F && S_ISREG(st->st_mode))
+        defrag_file(path);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct stat st;
+    int opt, i;
+    
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        switch (opt) {
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (optind >= argc)
+        goto usage;
+    
+    for (i = optind; i < argc; i++) {
+        if (stat(argv[i], &st) < 0) {
+            perror(argv[i]);
+            failed = 1;
+            continue;
+        }
+        /* 目录按文件树逐个整理，不跨越挂载点 */
+        if (S_ISDIR(st.st_mode))
+            nftw(argv[i], walk, 16, FTW_PHYS | FTW_MOUNT);
+        else
+            defrag_file(argv[i]);
+    }
+    
+    printf("Total: %llu blocks moved\n", total_moved);
+    return failed;
+    
+usage:
+    fprintf(stderr, "Usage: %s [-v] <file|dir>...\n", argv[0]);
+    exit(1);
+}
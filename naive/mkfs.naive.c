@@ -10,6 +10,12 @@
 #define NAIVE_BLOCK_SIZE 512
 #define NAIVE_INODE_SIZE 512
 #define NAIVE_ROOT_INODE_NO 1
+#define NAIVE_FEATURE_REFLINK 0x1
+#define NAIVE_FEATURE_INLINE_DATA 0x2
+#define NAIVE_FEATURE_XATTR 0x4
+#define NAIVE_INLINE_SIZE 264
+#define NAIVE_INODE_XATTR_SIZE 64
+#define NAIVE_INODE_INLINE_DATA 0x1
 
 /* 磁盘数据结构 - 与内核一致 */
 struct naive_super_block {
@@ -18,7 +24,15 @@ struct naive_super_block {
     unsigned int block_total;
     unsigned int inode_table_block_no;
     unsigned int data_block_no;
-    unsigned char padding[492];
+    unsigned int features;
+    unsigned int refcount_block_no;
+    unsigned int refcount_blocks;
+    unsigned int orphan_head;
+    unsigned int block_bitmap_blocks;
+    unsigned int bitmap_ext_block_no;
+    unsigned int refcount_base_blocks;
+    unsigned int refcount_ext_block_no;
+    unsigned char padding[460];
 };
 
 struct naive_inode {
@@ -36,7 +50,14 @@ struct naive_inode {
     unsigned int i_atime;
     unsigned int i_ctime;
     unsigned int i_mtime;
-    unsigned char padding[352];
+    unsigned int i_flags;
+    unsigned int i_ind_block;
+    unsigned int i_dind_block;
+    unsigned int i_blocks;
+    unsigned int i_xattr_block;
+    unsigned char i_xattr[NAIVE_INODE_XATTR_SIZE];
+    unsigned int i_next_orphan;
+    unsigned char i_inline[NAIVE_INLINE_SIZE];
 };
 
 struct naive_dir_record {
@@ -50,8 +71,8 @@ void format_disk(int fd, const char *path)
     struct naive_super_block nsb;
     unsigned char *bmap, *imap;
     struct naive_inode root_inode;
-    struct naive_dir_record dir_dot, dir_dotdot;
     int disk_size, inode_table_size;
+    unsigned int i;
     
     stat(path, &stat_);
     disk_size = stat_.st_size;
@@ -67,11 +88,18 @@ void format_disk(int fd, const char *path)
     // 计算布局
     inode_table_size = (nsb.inode_total * NAIVE_INODE_SIZE + NAIVE_BLOCK_SIZE - 1) / NAIVE_BLOCK_SIZE;
     nsb.inode_table_block_no = 4;  // 块0:引导, 块1:超级块, 块2:数据位图, 块3:inode位图
-    nsb.data_block_no = nsb.inode_table_block_no + inode_table_size;
+    
+    // inode表之后是块引用计数表，每个块一个字节；小文件内容存放在inode中
+    nsb.features = NAIVE_FEATURE_REFLINK | NAIVE_FEATURE_INLINE_DATA | NAIVE_FEATURE_XATTR;
+    nsb.refcount_block_no = nsb.inode_table_block_no + inode_table_size;
+    nsb.refcount_blocks = (nsb.block_total + NAIVE_BLOCK_SIZE - 1) / NAIVE_BLOCK_SIZE;
+    nsb.data_block_no = nsb.refcount_block_no + nsb.refcount_blocks;
     
     printf("  Block total: %d\n", nsb.block_total);
     printf("  Inode total: %d\n", nsb.inode_total);
     printf("  Inode table starts at block: %d\n", nsb.inode_table_block_no);
+    printf("  Refcount table starts at block: %d (%d blocks)\n",
+           nsb.refcount_block_no, nsb.refcount_blocks);
     printf("  Data blocks start at block: %d\n", nsb.data_block_no);
     
     // 分配位图
@@ -90,7 +118,7 @@ void format_disk(int fd, const char *path)
     
     // 写入超级块
     write(fd, &nsb, sizeof(nsb));
-    lseek(fd, NAIVE_BLOCK_SIZE, SEEK_SET);  // 填充到块边界
+    lseek(fd, 2 * NAIVE_BLOCK_SIZE, SEEK_SET);  // 填充到块边界
     
     // 写入数据块位图
     write(fd, bmap, NAIVE_BLOCK_SIZE);
@@ -102,9 +130,10 @@ void format_disk(int fd, const char *path)
     memset(&root_inode, 0, sizeof(root_inode));
     root_inode.mode = 040755;  // S_IFDIR | 0755
     root_inode.i_ino = NAIVE_ROOT_INODE_NO;
-    root_inode.block_count = 1;
-    root_inode.block[0] = nsb.data_block_no;
-    root_inode.dir_children_count = 2;  // . 和 ..
+    // 根目录以内联方式存放，不占数据块；.和..由VFS处理
+    root_inode.i_flags = NAIVE_INODE_INLINE_DATA;
+    root_inode.block_count = 0;
+    root_inode.dir_children_count = NAIVE_INLINE_SIZE / sizeof(struct naive_dir_record);
     root_inode.i_uid = getuid();
     root_inode.i_gid = getgid();
     root_inode.i_nlink = 2;
@@ -114,26 +143,10 @@ void format_disk(int fd, const char *path)
     lseek(fd, nsb.inode_table_block_no * NAIVE_BLOCK_SIZE, SEEK_SET);
     write(fd, &root_inode, sizeof(root_inode));
     
-    // 创建.和..目录项
-    memset(&dir_dot, 0, sizeof(dir_dot));
-    dir_dot.i_ino = NAIVE_ROOT_INODE_NO;
-    strcpy(dir_dot.filename, ".");
-    
-    memset(&dir_dotdot, 0, sizeof(dir_dotdot));
-    dir_dotdot.i_ino = NAIVE_ROOT_INODE_NO;
-    strcpy(dir_dotdot.filename, "..");
-    
-    // 写入根目录的数据块
-    lseek(fd, nsb.data_block_no * NAIVE_BLOCK_SIZE, SEEK_SET);
-    write(fd, &dir_dot, sizeof(dir_dot));
-    write(fd, &dir_dotdot, sizeof(dir_dotdot));
-    
-    // 标记数据块为已使用
-    bmap[nsb.data_block_no / 8] |= (1 << (nsb.data_block_no % 8));
-    
-    // 更新位图
-    lseek(fd, 2 * NAIVE_BLOCK_SIZE, SEEK_SET);
-    write(fd, bmap, NAIVE_BLOCK_SIZE);
+    // 清零块引用计数表
+    lseek(fd, nsb.refcount_block_no * NAIVE_BLOCK_SIZE, SEEK_SET);
+    for (i = 0; i < nsb.refcount_blocks; i++)
+        write(fd, zero_block, NAIVE_BLOCK_SIZE);
     
     free(bmap);
     free(imap);
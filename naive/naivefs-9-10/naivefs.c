@@ -192,13 +192,30 @@ static ssize_t naive_file_read(struct file *filp, char __user *buf,
         block_index = pos / NAIVE_BLOCK_SIZE;
         block_offset = pos % NAIVE_BLOCK_SIZE;
         
-        // 检查块指针是否有效
-        if (block_index >= NAIVE_DIRECT_BLOCKS || 
-            disk_inode->i_block[block_index] == 0) {
+        if (block_index >= NAIVE_DIRECT_BLOCKS) {
             printk(KERN_WARNING "naivefs: invalid block pointer at index %u\n", block_index);
             break;
         }
         
+        // 计算本次可以读取的字节数
+        size_t bytes_to_copy = len;
+        if (bytes_to_copy > NAIVE_BLOCK_SIZE - block_offset)
+            bytes_to_copy = NAIVE_BLOCK_SIZE - block_offset;
+        if (bytes_to_copy > file_size - pos)
+            bytes_to_copy = file_size - pos;
+        
+        // 块指针为0表示空洞，读出为0
+        if (disk_inode->i_block[block_index] == 0) {
+            if (clear_user(buf + bytes_read, bytes_to_copy)) {
+                bytes_read = -EFAULT;
+                break;
+            }
+            bytes_read += bytes_to_copy;
+            pos += bytes_to_copy;
+            len -= bytes_to_copy;
+            continue;
+        }
+        
         // 读取数据块
         bh = sb_bread(sb, le32_to_cpu(disk_inode->i_block[block_index]));
         if (!bh) {
@@ -207,13 +224,6 @@ static ssize_t naive_file_read(struct file *filp, char __user *buf,
             break;
         }
         
-        // 计算本次可以读取的字节数
-        size_t bytes_to_copy = len;
-        if (bytes_to_copy > NAIVE_BLOCK_SIZE - block_offset)
-            bytes_to_copy = NAIVE_BLOCK_SIZE - block_offset;
-        if (bytes_to_copy > file_size - pos)
-            bytes_to_copy = file_size - pos;
-        
         // 复制到用户空间
         if (copy_to_user(buf + bytes_read, bh->b_data + block_offset, bytes_to_copy)) {
             brelse(bh);
@@ -357,39 +367,13 @@ static ssize_t naive_file_write(struct file *filp, const char __user *buf,
 static int naive_unlink(struct inode *dir, struct dentry *dentry)
 {
     struct inode *inode = d_inode(dentry);
-    struct naive_inode_info *nii = NAIVE_I(inode);
-    struct naive_disk_inode *disk_inode = nii->disk_inode;
-    struct super_block *sb = dir->i_sb;
-    struct naive_sb_info *sbi = NAIVE_SB(sb);
     
     printk(KERN_INFO "naivefs: unlink called for %s (inode %lu)\n",
            dentry->d_name.name, inode->i_ino);
     
-    // 减少链接数
+    // 减少链接数；链接数为0时文件可能仍被打开，资源在naive_evict_inode中释放
     inode_dec_link_count(inode);
     
-    // 如果链接数为0，释放资源
-    if (inode->i_nlink == 0) {
-        printk(KERN_INFO "naivefs: inode %lu has 0 links, freeing resources\n", inode->i_ino);
-        
-        // 释放文件占用的数据块
-        naive_free_file_blocks(sb, disk_inode);
-        
-        // 清除inode内容
-        disk_inode->i_size = 0;
-        disk_inode->i_blocks = 0;
-        disk_inode->i_links_count = 0;
-        
-        // 释放inode位图
-        naive_clear_bit(inode->i_ino - 1, sbi->inode_bitmap);
-        mark_buffer_dirty(sbi->inode_bitmap_bh);
-        
-        // 标记inode缓冲区为脏
-        mark_buffer_dirty(nii->inode_bh);
-        
-        printk(KERN_INFO "naivefs: inode %lu resources freed\n", inode->i_ino);
-    }
-    
     // 更新目录修改时间
     struct timespec64 ts;
     ktime_get_real_ts64(&ts);
@@ -606,6 +590,40 @@ static int naive_write_inode(struct inode *inode, struct writeback_control *wbc)
     return 0;
 }
 
+// 清除inode：最后一个链接已删除且文件不再被打开时才释放块和inode编号
+static void naive_evict_inode(struct inode *inode)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    struct naive_disk_inode *disk_inode = nii->disk_inode;
+    struct super_block *sb = inode->i_sb;
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    
+    truncate_inode_pages_final(&inode->i_data);
+    
+    if (inode->i_nlink == 0 && disk_inode) {
+        printk(KERN_INFO "naivefs: inode %lu has 0 links, freeing resources\n", inode->i_ino);
+        
+        // 释放文件占用的数据块
+        naive_free_file_blocks(sb, disk_inode);
+        
+        // 清除inode内容
+        disk_inode->i_size = 0;
+        disk_inode->i_blocks = 0;
+        disk_inode->i_links_count = 0;
+        
+        // 释放inode位图
+        naive_clear_bit(inode->i_ino - 1, sbi->inode_bitmap);
+        mark_buffer_dirty(sbi->inode_bitmap_bh);
+        
+        // 标记inode缓冲区为脏
+        mark_buffer_dirty(nii->inode_bh);
+        
+        printk(KERN_INFO "naivefs: inode %lu resources freed\n", inode->i_ino);
+    }
+    
+    clear_inode(inode);
+}
+
 // 销毁inode
 static void naive_destroy_inode(struct inode *inode)
 {
@@ -624,6 +642,7 @@ static const struct super_operations naive_sops = {
     .statfs = simple_statfs,
     .drop_inode = generic_drop_inode,
     .write_inode = naive_write_inode,
+    .evict_inode = naive_evict_inode,
     .destroy_inode = naive_destroy_inode,
 };
 
@@ -5,16 +5,36 @@
 #include <linux/buffer_head.h>
 #include <linux/slab.h>
 #include <linux/mount.h>
+#include <linux/fs_context.h>
+#include <linux/fs_parser.h>
+#include <linux/workqueue.h>
+#include <linux/spinlock.h>
+#include <linux/seq_file.h>
+#include <linux/percpu.h>
+#include <linux/kobject.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
+#include <linux/iomap.h>
+#include <linux/fiemap.h>
 
 #define NAIVE_MAGIC 0x990717
 #define NAIVE_BLOCK_SIZE 512
 #define NAIVE_SUPER_BLOCK_BLOCK 1
+#define NAIVE_BLOCK_BITMAP_BLOCK 2
+#define NAIVE_INODE_BITMAP_BLOCK 3
 #define NAIVE_ROOT_INODE_NO 1
 #define NAIVE_MAX_FILENAME_LEN 128
 #define NAIVE_DIR_RECORD_SIZE 132  /* 4 + 128 */
 #define NAIVE_DIR_RECORDS_PER_BLOCK 3
-#define NAIVE_BLOCK_PER_FILE 8
-#define NAIVE_MAX_FILE_SIZE (NAIVE_BLOCK_SIZE * NAIVE_BLOCK_PER_FILE)
+#define NAIVE_BLOCK_PER_FILE 8      /* 直接指针数 */
+#define NAIVE_PTRS_PER_BLOCK (NAIVE_BLOCK_SIZE / sizeof(__le32))
+#define NAIVE_IND_FIRST NAIVE_BLOCK_PER_FILE        /* 一级间接块映射的第一个文件块 */
+#define NAIVE_DIND_FIRST (NAIVE_IND_FIRST + NAIVE_PTRS_PER_BLOCK)
+#define NAIVE_MAX_BLOCKS (NAIVE_DIND_FIRST + NAIVE_PTRS_PER_BLOCK * NAIVE_PTRS_PER_BLOCK)
+#define NAIVE_MAX_FILE_SIZE ((loff_t)NAIVE_BLOCK_SIZE * NAIVE_MAX_BLOCKS)
+#define NAIVE_INLINE_SIZE 264       /* inode尾部的内联区，恰好放下两条目录项 */
+#define NAIVE_INLINE_DIR_RECORDS (NAIVE_INLINE_SIZE / NAIVE_DIR_RECORD_SIZE)
+#define NAIVE_INODE_XATTR_SIZE 64   /* inode内的扩展属性区 */
 
 /* 磁盘数据结构 */
 struct naive_super_block {
@@ -23,9 +43,38 @@ struct naive_super_block {
     __le32 block_total;
     __le32 inode_table_block_no;
     __le32 data_block_no;
-    __u8 padding[492];
+    __le32 features;                /* NAIVE_FEATURE_* */
+    __le32 refcount_block_no;       /* 块引用计数表起始块 */
+    __le32 refcount_blocks;         /* 块引用计数表占用的块数 */
+    __le32 orphan_head;             /* 孤儿链表的第一个inode，0表示空 */
+    __le32 block_bitmap_blocks;     /* 块位图的块数，0表示1 */
+    __le32 bitmap_ext_block_no;     /* 块位图第1块起存放的位置（扩容后） */
+    __le32 refcount_base_blocks;    /* 在refcount_block_no处的引用计数块数 */
+    __le32 refcount_ext_block_no;   /* 其余引用计数块的位置（扩容后） */
+    __u8 padding[460];
 };
 
+/* 特性标志：挂载时遇到不认识的特性拒绝挂载 */
+#define NAIVE_FEATURE_REFLINK 0x1   /* 块可被多个文件共享，按引用计数表写时复制 */
+#define NAIVE_FEATURE_INLINE_DATA 0x2   /* 小文件的内容直接存放在inode中 */
+#define NAIVE_FEATURE_XATTR 0x4     /* 扩展属性，见naivefs_xattr.c */
+#define NAIVE_FEATURE_META_EXT 0x8  /* 在线扩容过，块位图和引用计数表有扩展区 */
+#define NAIVE_FEATURE_SUPPORTED (NAIVE_FEATURE_REFLINK | NAIVE_FEATURE_INLINE_DATA | \
+                                 NAIVE_FEATURE_XATTR | NAIVE_FEATURE_META_EXT)
+
+/*
+ * 块引用计数表：每个块一个字节，记录除第一个所有者之外的引用数。
+ * 0表示块未共享，释放块时先减引用计数，减到0之后才清除位图。
+ */
+#define NAIVE_REFCOUNT_MAX 255
+
+/*
+ * 块指针的最高位表示未写入：块已分配（fallocate预分配或写入点之前的空缺），
+ * 但内容未初始化，读出为0。
+ */
+#define NAIVE_BLOCK_UNWRITTEN 0x80000000U
+#define NAIVE_BLOCK_NO(ptr) ((ptr) & ~NAIVE_BLOCK_UNWRITTEN)
+
 struct naive_inode {
     __le32 mode;
     __le32 i_ino;
@@ -41,34 +90,248 @@ struct naive_inode {
     __le32 i_atime;
     __le32 i_ctime;
     __le32 i_mtime;
-    __u8 padding[352];
+    __le32 i_flags;                 /* NAIVE_INODE_* */
+    __le32 i_ind_block;             /* 一级间接块，0表示没有 */
+    __le32 i_dind_block;            /* 二级间接块，0表示没有 */
+    __le32 i_blocks;                /* 占用的块数，含间接块；旧镜像为0 */
+    __le32 i_xattr_block;           /* 扩展属性块，0表示没有 */
+    __u8 i_xattr[NAIVE_INODE_XATTR_SIZE];   /* inode内的扩展属性条目 */
+    __le32 i_next_orphan;           /* 孤儿链表中的下一个inode */
+    __u8 i_inline[NAIVE_INLINE_SIZE];   /* 内联数据 */
+};
+
+/* i_flags */
+#define NAIVE_INODE_INLINE_DATA 0x1 /* 内容在i_inline中，没有数据块 */
+
+/*
+ * 扩展属性条目。inode内和扩展属性块中格式相同：按4字节对齐依次存放，
+ * e_name_len为0或到达区域末尾表示结束。名字不含命名空间前缀。
+ */
+struct naive_xattr_entry {
+    __u8 e_name_index;              /* NAIVE_XATTR_INDEX_* */
+    __u8 e_name_len;
+    __le16 e_value_size;
+    char e_name[];                  /* 名字之后紧跟值 */
 };
 
+#define NAIVE_XATTR_INDEX_USER 1
+#define NAIVE_XATTR_INDEX_TRUSTED 2
+#define NAIVE_XATTR_INDEX_SECURITY 3
+
+#define NAIVE_XATTR_ENTRY_SIZE(name_len, value_size) \
+    ALIGN(sizeof(struct naive_xattr_entry) + (name_len) + (value_size), 4)
+
+/* 扩展属性块头，条目紧随其后。内容相同的扩展属性块由多个inode共享 */
+struct naive_xattr_header {
+    __le32 h_magic;                 /* NAIVE_XATTR_MAGIC */
+    __le32 h_refcount;              /* 引用这个块的inode数 */
+    __le32 h_hash;                  /* 条目的哈希，用于查找内容相同的块 */
+    __le32 h_reserved;
+};
+
+#define NAIVE_XATTR_MAGIC 0x58415452    /* "RTAX" */
+
 struct naive_dir_record {
     __le32 i_ino;
     char filename[NAIVE_MAX_FILENAME_LEN];
 };
 
+/* 在线整理（NAIVE_IOC_DEFRAG），以文件块为单位，defrag.naive中有同样的定义 */
+struct naive_defrag_range {
+    __u64 start;                    /* 起始文件块 */
+    __u64 len;                      /* 块数，超出文件末尾的部分忽略 */
+    __u64 moved;                    /* 返回：搬到连续空闲区的块数 */
+};
+
+#define NAIVE_IOC_DEFRAG _IOWR('N', 1, struct naive_defrag_range)
+
+/* 在线扩容到给定的总块数，0表示扩到整个设备；resize.naive中有同样的定义 */
+#define NAIVE_IOC_RESIZE _IOW('N', 2, __u64)
+
+/* 挂载选项 */
+enum naive_alloc_policy {
+    NAIVE_ALLOC_FIRST,      /* 每次从数据区起点查找空闲块 */
+    NAIVE_ALLOC_NEXT,       /* 从上次分配的位置继续查找 */
+};
+
+enum naive_atime_mode {
+    NAIVE_ATIME_NONE,       /* 读操作不更新atime */
+    NAIVE_ATIME_LAZY,       /* 只更新内存中的atime，随inode其他修改一起落盘 */
+    NAIVE_ATIME_STRICT,     /* 每次读都标记inode为脏 */
+};
+
+#define NAIVE_DEFAULT_COMMIT_INTERVAL 5     /* 秒 */
+#define NAIVE_DEFAULT_RA_BLOCKS 256         /* 128KB */
+#define NAIVE_MAX_RA_BLOCKS 16384           /* 8MB */
+#define NAIVE_DEFAULT_ICACHE_SIZE 1024
+#define NAIVE_DEFAULT_RECLAIM_BLOCKS 128    /* 64KB */
+#define NAIVE_RECLAIM_BATCH 1024            /* 后台回收每批释放的块数 */
+#define NAIVE_DISCARD_MAX_RUN 8192          /* 一次丢弃请求最多覆盖的块数（4MB） */
+
+struct naive_mount_opts {
+    unsigned int commit_interval;   /* 位图周期提交间隔（秒），0表示关闭 */
+    unsigned int alloc_policy;
+    unsigned int ra_blocks;         /* 顺序读时预读窗口的上限（块） */
+    unsigned int icache_size;       /* 内存中最多保留的inode数 */
+    unsigned int atime_mode;
+    unsigned int debug;             /* 调试输出级别 */
+    unsigned int reclaim_blocks;    /* 删除时超过这么多块的文件由后台释放，0表示关闭 */
+    unsigned int discard;           /* 释放的块在位图提交后丢弃 */
+};
+
+/* 性能计数器，导出到/sys/fs/naive/<dev>/ */
+enum naive_stat_item {
+    NAIVE_STAT_BLOCKS_ALLOCATED,
+    NAIVE_STAT_BLOCKS_FREED,
+    NAIVE_STAT_BLOCKS_DISCARDED,    /* 下发丢弃的块数，含FITRIM */
+    NAIVE_STAT_ALLOC_SCANS,         /* 位图查找次数 */
+    NAIVE_STAT_ALLOC_SCANNED_BITS,  /* 位图查找累计扫描的位数 */
+    NAIVE_STAT_LOOKUP_HITS,
+    NAIVE_STAT_LOOKUP_MISSES,
+    NAIVE_STAT_LOOKUP_DIR_BLOCKS,   /* 查找累计读取的目录块数 */
+    NAIVE_STAT_INODE_READS,
+    NAIVE_STAT_INODE_WRITES,
+    NAIVE_STAT_BYTES_READ,
+    NAIVE_STAT_BYTES_WRITTEN,
+    NAIVE_STAT_RA_SEQUENTIAL,       /* 判定为顺序访问的缓存读次数 */
+    NAIVE_STAT_RA_RANDOM,           /* 判定为随机访问的缓存读次数 */
+    NAIVE_STAT_NR,
+};
+
+enum naive_lat_item {
+    NAIVE_LAT_READ,
+    NAIVE_LAT_WRITE,
+    NAIVE_LAT_LOOKUP,
+    NAIVE_LAT_NR,
+};
+
+/* 延迟直方图：第0个桶为小于1微秒，第i个桶为[2^(i-1), 2^i)微秒，最后一个桶不设上限 */
+#define NAIVE_LAT_BUCKETS 16
+
+struct naive_stats {
+    u64 count[NAIVE_STAT_NR];
+    u64 lat[NAIVE_LAT_NR][NAIVE_LAT_BUCKETS];
+};
+
 /* 内存数据结构 */
 struct naive_sb_info {
+    struct super_block *sb;
     struct naive_super_block *disk_sb;
     struct buffer_head *sb_bh;
     unsigned char *block_bitmap;
     unsigned char *inode_bitmap;
     int block_bitmap_blocks;
     int inode_bitmap_blocks;
+    u32 bitmap_ext_block_no;
+    u8 *refcount;                   /* 块引用计数表，未启用reflink时为NULL */
+    int refcount_blocks;
+    int refcount_base_blocks;
+    u32 refcount_block_no;
+    u32 refcount_ext_block_no;
+    struct mutex commit_lock;       /* 串行化位图提交和扩容，扩容时位图的大小和位置会变 */
+    unsigned char *discard_bitmap;  /* 已释放、等待丢弃的块 */
+    spinlock_t bitmap_lock;         /* 保护三个位图、引用计数表、dirty标志和alloc_cursor */
+    bool bitmap_dirty;
+    bool refcount_dirty;
+    bool discard_pending;
+    struct mutex discard_lock;      /* 串行化丢弃，正在丢弃的块在位图中临时置位 */
+    unsigned long alloc_cursor;
+    struct naive_mount_opts opts;
+    struct delayed_work commit_work;
+    atomic_t nr_inodes;
+    struct naive_stats __percpu *stats;
+    struct kobject s_kobj;
+    struct completion s_kobj_unregister;
+    struct mb_cache *xattr_cache;   /* 按内容哈希索引扩展属性块，未启用扩展属性时为NULL */
+    struct mutex xattr_lock;        /* 串行化扩展属性块的共享和引用计数 */
+    struct list_head orphan_list;   /* 孤儿inode，顺序与磁盘上的链表相同 */
+    struct mutex orphan_lock;       /* 保护orphan_list、磁盘上的链表头和i_next_orphan */
+    struct list_head reclaim_list;  /* 等待后台释放块的已删除inode */
+    spinlock_t reclaim_lock;
+    struct work_struct reclaim_work;
+    bool reclaim_off;               /* 为真时删除的文件都在evict_inode中同步释放 */
 };
 
 struct naive_inode_info {
     struct naive_inode *disk_inode;
     struct buffer_head *inode_bh;
     int block_count;
-    int block_pointers[NAIVE_BLOCK_PER_FILE];
+    u32 block_pointers[NAIVE_BLOCK_PER_FILE];
+    u32 i_ind_block;
+    u32 i_dind_block;
+    struct buffer_head *ind_bh;     /* 最近使用的叶子间接块 */
+    sector_t ind_base;              /* ind_bh映射的第一个文件块 */
+    u32 i_flags;                    /* NAIVE_INODE_* */
+    void *inline_data;              /* 内联数据，转为块后保留到inode销毁 */
+    u32 i_xattr_block;
+    u8 i_xattr[NAIVE_INODE_XATTR_SIZE];
+    struct rw_semaphore xattr_sem;  /* 保护i_xattr和i_xattr_block */
+    u32 i_next_orphan;
+    struct list_head i_orphan;      /* 挂在sbi->orphan_list上 */
+    struct list_head i_reclaim;     /* 挂在sbi->reclaim_list上 */
+    struct mutex block_lock;        /* 保护块指针、间接块、i_flags；缺页时分配块不持有inode锁 */
+    spinlock_t ioend_lock;          /* 保护ioend_list，在bio完成回调中获取 */
+    struct list_head ioend_list;    /* 已完成、等待naive_end_io_work处理的回写ioend */
+    struct work_struct ioend_work;
     struct inode vfs_inode;
 };
 
+/* 每个打开文件的顺序读检测状态，挂在file->private_data上 */
+struct naive_file_info {
+    loff_t ra_next;                 /* 上次读结束的位置，下一次从这里读即为顺序读 */
+    unsigned int ra_window;         /* 当前预读窗口（页） */
+};
+
+#define NAIVE_RA_MIN_PAGES 4U       /* 顺序读开始时的初始窗口 */
+
 #define NAIVE_SB(sb) ((struct naive_sb_info *)(sb->s_fs_info))
-#define NAIVE_I(inode) ((struct naive_inode_info *)(inode))
+#define NAIVE_I(inode) container_of(inode, struct naive_inode_info, vfs_inode)
+
+static inline bool naive_has_feature(struct naive_sb_info *sbi, u32 feature)
+{
+    return le32_to_cpu(sbi->disk_sb->features) & feature;
+}
+
+static inline bool naive_has_inline_data(struct inode *inode)
+{
+    return NAIVE_I(inode)->i_flags & NAIVE_INODE_INLINE_DATA;
+}
+
+/* 内联目录的第i条目录项；内联目录不保存.和..，它们由VFS处理 */
+static inline struct naive_dir_record *naive_inline_record(struct inode *dir, int i)
+{
+    return (struct naive_dir_record *)
+           (NAIVE_I(dir)->inline_data + i * NAIVE_DIR_RECORD_SIZE);
+}
+
+/* 按挂载选项debug=<level>输出调试信息 */
+#define naive_debug(sb, level, fmt, ...)                                \
+    do {                                                                \
+        if (NAIVE_SB(sb)->opts.debug >= (level))                        \
+            printk(KERN_INFO "naivefs: " fmt, ##__VA_ARGS__);           \
+    } while (0)
+
+static inline void naive_stat_add(struct naive_sb_info *sbi,
+                                  enum naive_stat_item item, u64 val)
+{
+    this_cpu_add(sbi->stats->count[item], val);
+}
+
+static inline void naive_stat_inc(struct naive_sb_info *sbi,
+                                  enum naive_stat_item item)
+{
+    this_cpu_inc(sbi->stats->count[item]);
+}
+
+/* 记录从start_ns到现在的延迟 */
+static inline void naive_stat_latency(struct naive_sb_info *sbi,
+                                      enum naive_lat_item item, u64 start_ns)
+{
+    u64 us = div_u64(ktime_get_ns() - start_ns, NSEC_PER_USEC);
+    int bucket = us ? min_t(int, ilog2(us) + 1, NAIVE_LAT_BUCKETS - 1) : 0;
+    
+    this_cpu_inc(sbi->stats->lat[item][bucket]);
+}
 
 /* ========== 所有函数声明 ========== */
 
@@ -76,39 +339,130 @@ struct naive_inode_info {
 extern const struct super_operations naive_sops;
 extern const struct inode_operations naive_dir_iops;
 extern const struct inode_operations naive_file_iops;
+extern const struct inode_operations naive_symlink_iops;
+extern const struct inode_operations naive_fast_symlink_iops;
 extern const struct file_operations naive_file_ops;
+extern const struct file_operations naive_dir_ops;
+extern const struct address_space_operations naive_aops;
 
 /* 超级块函数 */
 struct inode *naive_alloc_inode(struct super_block *sb);
-void naive_destroy_inode(struct inode *inode);
+void naive_free_inode(struct inode *inode);
 void naive_put_super(struct super_block *sb);
 int naive_write_inode(struct inode *inode, struct writeback_control *wbc);
 void naive_evict_inode(struct inode *inode);
-int naive_fill_super(struct super_block *sb, void *data, int silent);
+int naive_drop_inode(struct inode *inode);
+int naive_sync_fs(struct super_block *sb, int wait);
+int naive_show_options(struct seq_file *seq, struct dentry *root);
+int naive_fill_super(struct super_block *sb, struct fs_context *fc);
+void naive_kill_sb(struct super_block *sb);
+
+/* 挂载选项 */
+extern const struct fs_parameter_spec naive_fs_parameters[];
+int naive_init_fs_context(struct fs_context *fc);
 
 /* 目录操作 */
 int naive_create(struct mnt_idmap *idmap, struct inode *dir,
                 struct dentry *dentry, umode_t mode, bool excl);
-int naive_lookup(struct inode *dir, struct dentry *dentry, unsigned int flags);
+struct dentry *naive_lookup(struct inode *dir, struct dentry *dentry, unsigned int flags);
 int naive_unlink(struct inode *dir, struct dentry *dentry);
 int naive_mkdir(struct mnt_idmap *idmap, struct inode *dir,
                struct dentry *dentry, umode_t mode);
 int naive_rmdir(struct inode *dir, struct dentry *dentry);
+int naive_symlink(struct mnt_idmap *idmap, struct inode *dir,
+                 struct dentry *dentry, const char *symname);
+int naive_link(struct dentry *old_dentry, struct inode *dir,
+              struct dentry *dentry);
+int naive_rename(struct mnt_idmap *idmap, struct inode *old_dir,
+                struct dentry *old_dentry, struct inode *new_dir,
+                struct dentry *new_dentry, unsigned int flags);
+void naive_delete_inode(struct inode *inode);
 struct inode *naive_iget(struct super_block *sb, unsigned long ino);
 
 /* 文件操作 */
 int naive_file_open(struct inode *inode, struct file *filp);
 int naive_file_release(struct inode *inode, struct file *filp);
-ssize_t naive_file_read(struct file *filp, char __user *buf, size_t len, loff_t *pos);
-ssize_t naive_file_write(struct file *filp, const char __user *buf, size_t len, loff_t *pos);
+ssize_t naive_file_read_iter(struct kiocb *iocb, struct iov_iter *to);
+ssize_t naive_file_write_iter(struct kiocb *iocb, struct iov_iter *from);
+int naive_file_mmap(struct file *file, struct vm_area_struct *vma);
+loff_t naive_file_llseek(struct file *file, loff_t offset, int whence);
+ssize_t naive_copy_file_range(struct file *file_in, loff_t pos_in,
+                              struct file *file_out, loff_t pos_out,
+                              size_t len, unsigned int flags);
+loff_t naive_remap_file_range(struct file *file_in, loff_t pos_in,
+                              struct file *file_out, loff_t pos_out,
+                              loff_t len, unsigned int remap_flags);
+long naive_fallocate(struct file *file, int mode, loff_t offset, loff_t len);
+int naive_update_time(struct inode *inode, int flags);
+int naive_setattr(struct mnt_idmap *idmap, struct dentry *dentry,
+                  struct iattr *iattr);
+int naive_fiemap(struct inode *inode, struct fiemap_extent_info *fieinfo,
+                 u64 start, u64 len);
+int naive_symlink_write(struct inode *inode, const char *symname,
+                        unsigned int len);
+int naive_defrag_file(struct file *file, struct naive_defrag_range *range);
+
+/* 块映射（iomap） */
+extern const struct iomap_ops naive_iomap_ops;
+void naive_end_io_work(struct work_struct *work);
+
+/* naive_get_block()的create参数 */
+#define NAIVE_GET_BLOCK_CREATE 0x1      /* 空洞处分配新块 */
+#define NAIVE_GET_BLOCK_UNWRITTEN 0x2   /* 新块标记为未写入 */
+#define NAIVE_GET_BLOCK_NOWAIT 0x4      /* block_lock被占用时返回-EAGAIN */
+int naive_get_block(struct inode *inode, sector_t iblock,
+                    unsigned int max_blocks, int create,
+                    u32 *bno, bool *new);
+void naive_free_blocks_from(struct inode *inode, sector_t first_block);
+sector_t naive_free_tail_blocks(struct inode *inode, sector_t count);
+
+/* 块指针：直接、一级和二级间接（naivefs_bmap.c），调用者持有block_lock */
+int naive_bmap_read(struct inode *inode, sector_t blk, u32 *ptr);
+int naive_bmap_write(struct inode *inode, sector_t blk, u32 ptr);
+int naive_bmap_reserve(struct inode *inode, sector_t blk, unsigned long goal);
+void naive_bmap_unreserve(struct inode *inode, sector_t blk);
+sector_t naive_bmap_span(sector_t blk);
+void naive_bmap_release(struct inode *inode);
 
 /* 目录项操作 */
 int naive_add_entry(struct inode *dir, struct dentry *dentry, int ino);
 int naive_remove_entry(struct inode *dir, struct dentry *dentry);
 
+/* 扩展属性（naivefs_xattr.c） */
+extern const struct xattr_handler * const naive_xattr_handlers[];
+ssize_t naive_listxattr(struct dentry *dentry, char *buffer, size_t size);
+int naive_init_security(struct inode *inode, struct inode *dir,
+                        const struct qstr *qstr);
+void naive_xattr_delete_inode(struct inode *inode);
+int naive_xattr_init(struct super_block *sb);
+void naive_xattr_exit(struct super_block *sb);
+
+/* sysfs */
+int naive_sysfs_init(void);
+void naive_sysfs_exit(void);
+int naive_register_sysfs(struct super_block *sb);
+void naive_unregister_sysfs(struct super_block *sb);
+
 /* 块管理 */
-int naive_find_free_inode(struct naive_sb_info *sbi);
+int naive_alloc_ino(struct naive_sb_info *sbi);
+int naive_alloc_blocks(struct naive_sb_info *sbi, unsigned long goal,
+                       unsigned int count, u32 *start);
 int naive_alloc_block(struct naive_sb_info *sbi);
+int naive_alloc_run(struct naive_sb_info *sbi, unsigned long goal,
+                    unsigned int count, u32 *start);
 void naive_free_block(struct naive_sb_info *sbi, int block_no);
+void naive_free_blocks(struct naive_sb_info *sbi, u32 block_no, unsigned int count);
+int naive_ref_block(struct naive_sb_info *sbi, u32 block_no);
+unsigned int naive_shared_extent(struct naive_sb_info *sbi, u32 block_no,
+                                 unsigned int count, bool *shared);
+void naive_mark_inode_bitmap(struct naive_sb_info *sbi, int ino, bool used);
+void naive_orphan_add(struct inode *inode);
+int naive_commit_bitmaps(struct super_block *sb, int wait);
+void naive_issue_discards(struct super_block *sb);
+int naive_trim_fs(struct super_block *sb, struct fstrim_range *range);
+int naive_resize_fs(struct super_block *sb, u64 new_total);
+
+/* ioctl（naivefs_ioctl.c） */
+long naive_ioctl(struct file *filp, unsigned int cmd, unsigned long arg);
 
 #endif /* _NAIVEFS_H */
@@ -0,0 +1,271 @@
+#include "naivefs.h"
+
+/*
+ * 块指针：文件的前NAIVE_BLOCK_PER_FILE块由inode中的直接指针映射，之后的
+ * NAIVE_PTRS_PER_BLOCK块经过一级间接块，再之后经过二级间接块。旧镜像只有
+ * 直接指针，i_ind_block和i_dind_block为0，仍可直接读取。
+ *
+ * 间接块是元数据，经过块设备的缓冲区缓存读写，并挂在inode上由fsync写回。
+ * 最近使用的一个叶子间接块缓存在inode中，顺序访问时不必重复查找。
+ * 本文件的函数都要求调用者持有block_lock。
+ */
+
+/* 映射第blk块的叶子间接块所映射的第一个文件块 */
+static sector_t naive_leaf_base(sector_t blk)
+{
+    if (blk < NAIVE_DIND_FIRST)
+        return NAIVE_IND_FIRST;
+    return NAIVE_DIND_FIRST +
+           round_down(blk - NAIVE_DIND_FIRST, NAIVE_PTRS_PER_BLOCK);
+}
+
+static struct buffer_head *naive_ind_read(struct inode *inode, u32 bno)
+{
+    struct buffer_head *bh = sb_bread(inode->i_sb, bno);
+    
+    return bh ? bh : ERR_PTR(-EIO);
+}
+
+/* 分配一个清零的间接块，计入inode的i_blocks */
+static struct buffer_head *naive_ind_new(struct inode *inode, unsigned long goal,
+                                         u32 *bno)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    struct buffer_head *bh;
+    int ret;
+    
+    ret = naive_alloc_blocks(sbi, goal, 1, bno);
+    if (ret < 0)
+        return ERR_PTR(ret);
+    
+    /* 块可能刚被当作数据块用过，不读旧内容 */
+    bh = sb_getblk(inode->i_sb, *bno);
+    if (!bh) {
+        naive_free_block(sbi, *bno);
+        return ERR_PTR(-ENOMEM);
+    }
+    lock_buffer(bh);
+    memset(bh->b_data, 0, NAIVE_BLOCK_SIZE);
+    set_buffer_uptodate(bh);
+    unlock_buffer(bh);
+    mark_buffer_dirty_inode(bh, inode);
+    
+    inode_add_bytes(inode, NAIVE_BLOCK_SIZE);
+    return bh;
+}
+
+/* 释放一个间接块；丢弃其缓冲区，避免回写到已被复用的块 */
+static void naive_ind_free(struct inode *inode, struct buffer_head *bh)
+{
+    u32 bno = bh->b_blocknr;
+    
+    bforget(bh);
+    naive_free_block(NAIVE_SB(inode->i_sb), bno);
+    inode_sub_bytes(inode, NAIVE_BLOCK_SIZE);
+}
+
+/*
+ * 返回映射第blk块（blk >= NAIVE_IND_FIRST）的叶子间接块。不存在时，create
+ * 为真则以goal为提示分配，否则返回NULL。返回的缓冲区由inode缓存持有，
+ * 调用者不释放。
+ */
+static struct buffer_head *naive_ind_leaf(struct inode *inode, sector_t blk,
+                                          bool create, unsigned long goal)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    sector_t base = naive_leaf_base(blk);
+    struct buffer_head *bh, *dbh;
+    bool new_dind = false;
+    __le32 *slot;
+    u32 bno;
+    
+    if (nii->ind_bh && nii->ind_base == base)
+        return nii->ind_bh;
+    
+    if (blk < NAIVE_DIND_FIRST) {
+        if (nii->i_ind_block) {
+            bh = naive_ind_read(inode, nii->i_ind_block);
+        } else if (create) {
+            bh = naive_ind_new(inode, goal, &bno);
+            if (!IS_ERR(bh)) {
+                nii->i_ind_block = bno;
+                mark_inode_dirty(inode);
+            }
+        } else {
+            return NULL;
+        }
+    } else {
+        if (nii->i_dind_block) {
+            dbh = naive_ind_read(inode, nii->i_dind_block);
+        } else if (create) {
+            dbh = naive_ind_new(inode, goal, &bno);
+            if (!IS_ERR(dbh)) {
+                nii->i_dind_block = bno;
+                new_dind = true;
+                mark_inode_dirty(inode);
+            }
+        } else {
+            return NULL;
+        }
+        if (IS_ERR(dbh))
+            return dbh;
+        
+        slot = (__le32 *)dbh->b_data + (blk - NAIVE_DIND_FIRST) / NAIVE_PTRS_PER_BLOCK;
+        if (*slot) {
+            bh = naive_ind_read(inode, le32_to_cpu(*slot));
+        } else if (create) {
+            bh = naive_ind_new(inode, goal, &bno);
+            if (!IS_ERR(bh)) {
+                *slot = cpu_to_le32(bno);
+                mark_buffer_dirty_inode(dbh, inode);
+            } else if (new_dind) {
+                /* 不留下空的二级间接块 */
+                naive_ind_free(inode, dbh);
+                nii->i_dind_block = 0;
+                return bh;
+            }
+        } else {
+            brelse(dbh);
+            return NULL;
+        }
+        brelse(dbh);
+    }
+    if (IS_ERR(bh))
+        return bh;
+    
+    brelse(nii->ind_bh);
+    nii->ind_bh = bh;
+    nii->ind_base = base;
+    return bh;
+}
+
+/* 叶子间接块已全部为空洞：释放它，二级间接块随之变空时一并释放 */
+static void naive_ind_drop_leaf(struct inode *inode, sector_t blk)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    struct buffer_head *dbh;
+    __le32 *slot;
+    
+    naive_ind_free(inode, nii->ind_bh);
+    nii->ind_bh = NULL;
+    
+    if (blk < NAIVE_DIND_FIRST) {
+        nii->i_ind_block = 0;
+    } else {
+        dbh = naive_ind_read(inode, nii->i_dind_block);
+        if (IS_ERR(dbh))
+            return;
+        slot = (__le32 *)dbh->b_data + (blk - NAIVE_DIND_FIRST) / NAIVE_PTRS_PER_BLOCK;
+        *slot = 0;
+        if (!memchr_inv(dbh->b_data, 0, NAIVE_BLOCK_SIZE)) {
+            naive_ind_free(inode, dbh);
+            nii->i_dind_block = 0;
+        } else {
+            mark_buffer_dirty_inode(dbh, inode);
+            brelse(dbh);
+        }
+    }
+    mark_inode_dirty(inode);
+}
+
+/* 读第blk块的块指针（可能带NAIVE_BLOCK_UNWRITTEN），0为空洞 */
+int naive_bmap_read(struct inode *inode, sector_t blk, u32 *ptr)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    struct buffer_head *bh;
+    
+    *ptr = 0;
+    if (blk >= nii->block_count)
+        return 0;
+    if (blk < NAIVE_BLOCK_PER_FILE) {
+        *ptr = nii->block_pointers[blk];
+        return 0;
+    }
+    
+    bh = naive_ind_leaf(inode, blk, false, 0);
+    if (IS_ERR(bh))
+        return PTR_ERR(bh);
+    if (bh)
+        *ptr = le32_to_cpu(((__le32 *)bh->b_data)[blk - nii->ind_base]);
+    return 0;
+}
+
+/*
+ * 设置第blk块的块指针，需要时分配间接块；清成空洞后间接块为空则释放。
+ * 只维护block_count的上界，末尾空洞由调用者裁剪。
+ */
+int naive_bmap_write(struct inode *inode, sector_t blk, u32 ptr)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    struct buffer_head *bh;
+    
+    if (blk >= NAIVE_MAX_BLOCKS)
+        return -EFBIG;
+    
+    if (blk < NAIVE_BLOCK_PER_FILE) {
+        nii->block_pointers[blk] = ptr;
+    } else {
+        bh = naive_ind_leaf(inode, blk, ptr != 0, 0);
+        if (IS_ERR(bh))
+            return PTR_ERR(bh);
+        if (!bh)
+            return 0;
+        
+        ((__le32 *)bh->b_data)[blk - nii->ind_base] = cpu_to_le32(ptr);
+        if (!ptr && !memchr_inv(bh->b_data, 0, NAIVE_BLOCK_SIZE))
+            naive_ind_drop_leaf(inode, blk);
+        else
+            mark_buffer_dirty_inode(bh, inode);
+    }
+    
+    if (ptr && blk >= nii->block_count)
+        nii->block_count = blk + 1;
+    mark_inode_dirty(inode);
+    return 0;
+}
+
+/*
+ * 确保映射第blk块的间接块存在。分配数据块之前调用，使间接块落在
+ * 数据之前而不打断随后的连续数据块。
+ */
+int naive_bmap_reserve(struct inode *inode, sector_t blk, unsigned long goal)
+{
+    if (blk < NAIVE_BLOCK_PER_FILE)
+        return 0;
+    if (blk >= NAIVE_MAX_BLOCKS)
+        return -EFBIG;
+    return PTR_ERR_OR_ZERO(naive_ind_leaf(inode, blk, true, goal));
+}
+
+/*
+ * naive_bmap_reserve之后数据块分配失败时调用：映射第blk块的叶子间接块
+ * 仍全为空洞则释放，不把空的间接块留在inode上。截断只沿非零指针释放
+ * 间接块，空的叶子否则永远不会被释放。
+ */
+void naive_bmap_unreserve(struct inode *inode, sector_t blk)
+{
+    struct buffer_head *bh;
+    
+    if (blk < NAIVE_BLOCK_PER_FILE || blk >= NAIVE_MAX_BLOCKS)
+        return;
+    bh = naive_ind_leaf(inode, blk, false, 0);
+    if (!IS_ERR_OR_NULL(bh) && !memchr_inv(bh->b_data, 0, NAIVE_BLOCK_SIZE))
+        naive_ind_drop_leaf(inode, blk);
+}
+
+/* 从第blk块到同一个叶子间接块（或直接指针区）末尾的块数 */
+sector_t naive_bmap_span(sector_t blk)
+{
+    if (blk < NAIVE_IND_FIRST)
+        return NAIVE_IND_FIRST - blk;
+    return naive_leaf_base(blk) + NAIVE_PTRS_PER_BLOCK - blk;
+}
+
+/* 释放缓存的叶子间接块，inode被回收时调用 */
+void naive_bmap_release(struct inode *inode)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    
+    brelse(nii->ind_bh);
+    nii->ind_bh = NULL;
+}
@@ -3,6 +3,66 @@
 #include <linux/namei.h>
 #include <linux/pagemap.h>
 
+#include "trace/events/naivefs.h"
+
+/* 目录项的位置：内联目录项的bh为NULL */
+struct naive_dir_slot {
+    struct buffer_head *bh;
+    struct naive_dir_record *record;
+};
+
+/* 填写一条目录项 */
+static void naive_set_record(struct naive_dir_record *record,
+                             struct dentry *dentry, int ino)
+{
+    record->i_ino = cpu_to_le32(ino);
+    strncpy(record->filename, dentry->d_name.name, NAIVE_MAX_FILENAME_LEN);
+    record->filename[NAIVE_MAX_FILENAME_LEN - 1] = '\0';
+}
+
+/*
+ * 内联目录写满：把内联的目录项搬到新分配的块中，之后按普通目录处理。
+ * 调用者持有目录的inode锁。
+ */
+static int naive_dir_inline_to_block(struct inode *dir)
+{
+    struct naive_inode_info *nii = NAIVE_I(dir);
+    struct super_block *sb = dir->i_sb;
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    struct buffer_head *bh;
+    int block_no;
+    
+    block_no = naive_alloc_block(sbi);
+    if (block_no < 0)
+        return -ENOSPC;
+    
+    bh = sb_getblk(sb, block_no);
+    if (!bh) {
+        naive_free_block(sbi, block_no);
+        return -EIO;
+    }
+    lock_buffer(bh);
+    memset(bh->b_data, 0, NAIVE_BLOCK_SIZE);
+    memcpy(bh->b_data, nii->inline_data,
+           NAIVE_INLINE_DIR_RECORDS * NAIVE_DIR_RECORD_SIZE);
+    set_buffer_uptodate(bh);
+    unlock_buffer(bh);
+    mark_buffer_dirty(bh);
+    brelse(bh);
+    
+    mutex_lock(&nii->block_lock);
+    nii->block_pointers[0] = block_no;
+    nii->block_count = 1;
+    nii->i_flags &= ~NAIVE_INODE_INLINE_DATA;
+    memset(nii->inline_data, 0, NAIVE_INLINE_SIZE);
+    mutex_unlock(&nii->block_lock);
+    
+    inode_add_bytes(dir, NAIVE_BLOCK_SIZE);
+    dir->i_size = NAIVE_BLOCK_SIZE;
+    mark_inode_dirty(dir);
+    return 0;
+}
+
 /* 添加目录项 */
 int naive_add_entry(struct inode *dir, struct dentry *dentry, int ino)
 {
@@ -12,6 +72,23 @@ int naive_add_entry(struct inode *dir, struct dentry *dentry, int ino)
     struct naive_dir_record *record;
     int i, j;
     int found = 0;
+    int ret;
+    
+    if (naive_has_inline_data(dir)) {
+        for (j = 0; j < NAIVE_INLINE_DIR_RECORDS; j++) {
+            record = naive_inline_record(dir, j);
+            if (le32_to_cpu(record->i_ino) == 0) {
+                naive_set_record(record, dentry, ino);
+                mark_inode_dirty(dir);
+                trace_naivefs_add_entry(dir, dentry, ino);
+                return 0;
+            }
+        }
+        
+        ret = naive_dir_inline_to_block(dir);
+        if (ret)
+            return ret;
+    }
     
     for (i = 0; i < nii->block_count; i++) {
         if (nii->block_pointers[i] == 0)
@@ -34,7 +111,6 @@ int naive_add_entry(struct inode *dir, struct dentry *dentry, int ino)
                 record->filename[NAIVE_MAX_FILENAME_LEN - 1] = '\0';
                 
                 mark_buffer_dirty(bh);
-                brelse(bh);
                 found = 1;
                 break;
             }
@@ -47,19 +123,19 @@ int naive_add_entry(struct inode *dir, struct dentry *dentry, int ino)
     if (!found) {
         /* 需要分配新的数据块 */
         struct naive_sb_info *sbi = NAIVE_SB(sb);
-        int new_block = naive_alloc_block(sbi);
-        
-        if (new_block < 0)
-            return -ENOSPC;
+        int new_block;
         
-        /* 添加到inode块指针数组 */
+        /* 目录只用直接块，直接指针用完时目录已满 */
         for (i = 0; i < NAIVE_BLOCK_PER_FILE; i++) {
-            if (nii->block_pointers[i] == 0) {
-                nii->block_pointers[i] = new_block;
-                nii->block_count++;
+            if (nii->block_pointers[i] == 0)
                 break;
-            }
         }
+        if (i == NAIVE_BLOCK_PER_FILE)
+            return -ENOSPC;
+        
+        new_block = naive_alloc_block(sbi);
+        if (new_block < 0)
+            return -ENOSPC;
         
         /* 初始化新块 */
         bh = sb_bread(sb, new_block);
@@ -68,6 +144,11 @@ int naive_add_entry(struct inode *dir, struct dentry *dentry, int ino)
             return -EIO;
         }
         
+        /* 添加到inode块指针数组 */
+        nii->block_pointers[i] = new_block;
+        nii->block_count++;
+        inode_add_bytes(dir, NAIVE_BLOCK_SIZE);
+        
         memset(bh->b_data, 0, NAIVE_BLOCK_SIZE);
         record = (struct naive_dir_record *)bh->b_data;
         record->i_ino = cpu_to_le32(ino);
@@ -83,11 +164,24 @@ int naive_add_entry(struct inode *dir, struct dentry *dentry, int ino)
         mark_inode_dirty(dir);
     }
     
+    trace_naivefs_add_entry(dir, dentry, ino);
     return 0;
 }
 
-/* 从目录中移除条目 */
-int naive_remove_entry(struct inode *dir, struct dentry *dentry)
+/* 目录项是否名为name */
+static bool naive_record_match(struct naive_dir_record *record,
+                               const struct qstr *name)
+{
+    return le32_to_cpu(record->i_ino) != 0 &&
+           strncmp(record->filename, name->name, NAIVE_MAX_FILENAME_LEN) == 0;
+}
+
+/*
+ * 查找名为name的目录项。找到时返回0，slot指向该目录项；目录项在数据块中时
+ * slot持有其缓冲区，由naive_put_entry()释放。
+ */
+static int naive_find_entry(struct inode *dir, const struct qstr *name,
+                            struct naive_dir_slot *slot)
 {
     struct naive_inode_info *nii = NAIVE_I(dir);
     struct super_block *sb = dir->i_sb;
@@ -95,6 +189,19 @@ int naive_remove_entry(struct inode *dir, struct dentry *dentry)
     struct naive_dir_record *record;
     int i, j;
     
+    slot->bh = NULL;
+    
+    if (naive_has_inline_data(dir)) {
+        for (j = 0; j < NAIVE_INLINE_DIR_RECORDS; j++) {
+            record = naive_inline_record(dir, j);
+            if (naive_record_match(record, name)) {
+                slot->record = record;
+                return 0;
+            }
+        }
+        return -ENOENT;
+    }
+    
     for (i = 0; i < nii->block_count; i++) {
         if (nii->block_pointers[i] == 0)
             continue;
@@ -106,19 +213,9 @@ int naive_remove_entry(struct inode *dir, struct dentry *dentry)
         for (j = 0; j < NAIVE_DIR_RECORDS_PER_BLOCK; j++) {
             record = (struct naive_dir_record *)
                      (bh->b_data + j * NAIVE_DIR_RECORD_SIZE);
-            
-            /* 找到匹配的目录项 */
-            if (le32_to_cpu(record->i_ino) != 0 &&
-                strncmp(record->filename, dentry->d_name.name,
-                       NAIVE_MAX_FILENAME_LEN) == 0) {
-                
-                /* 清空目录项 */
-                record->i_ino = 0;
-                memset(record->filename, 0, NAIVE_MAX_FILENAME_LEN);
-                
-                mark_buffer_dirty(bh);
-                brelse(bh);
-                
+            if (naive_record_match(record, name)) {
+                slot->bh = bh;
+                slot->record = record;
                 return 0;
             }
         }
@@ -128,6 +225,47 @@ int naive_remove_entry(struct inode *dir, struct dentry *dentry)
     return -ENOENT;
 }
 
+static void naive_put_entry(struct naive_dir_slot *slot)
+{
+    brelse(slot->bh);
+    slot->bh = NULL;
+}
+
+/* 目录项已被修改，标记其所在的缓冲区或内联区为脏 */
+static void naive_dirty_entry(struct inode *dir, struct naive_dir_slot *slot)
+{
+    if (slot->bh)
+        mark_buffer_dirty(slot->bh);
+    else
+        mark_inode_dirty(dir);
+}
+
+/* 就地把目录项改为指向ino，只写这一条目录项 */
+static void naive_set_entry(struct inode *dir, struct naive_dir_slot *slot, int ino)
+{
+    slot->record->i_ino = cpu_to_le32(ino);
+    naive_dirty_entry(dir, slot);
+}
+
+/* 从目录中移除条目 */
+int naive_remove_entry(struct inode *dir, struct dentry *dentry)
+{
+    struct naive_dir_slot slot;
+    int ret;
+    
+    ret = naive_find_entry(dir, &dentry->d_name, &slot);
+    if (ret)
+        return ret;
+    
+    trace_naivefs_remove_entry(dir, dentry, le32_to_cpu(slot.record->i_ino));
+    
+    /* 清空目录项 */
+    memset(slot.record, 0, NAIVE_DIR_RECORD_SIZE);
+    naive_dirty_entry(dir, &slot);
+    naive_put_entry(&slot);
+    return 0;
+}
+
 /* 创建目录 */
 int naive_mkdir(struct mnt_idmap *idmap, struct inode *dir,
                struct dentry *dentry, umode_t mode)
@@ -142,10 +280,8 @@ int naive_mkdir(struct mnt_idmap *idmap, struct inode *dir,
     int block_no;
     int ino;
     
-    printk(KERN_INFO "naivefs: mkdir called for %s\n", dentry->d_name.name);
-    
     /* 分配新的inode编号 */
-    ino = naive_find_free_inode(sbi);
+    ino = naive_alloc_ino(sbi);
     if (ino == 0) {
         ret = -ENOSPC;
         goto out;
@@ -154,11 +290,22 @@ int naive_mkdir(struct mnt_idmap *idmap, struct inode *dir,
     /* 分配inode对象 */
     inode = new_inode(sb);
     if (!inode) {
+        naive_mark_inode_bitmap(sbi, ino, false);
         ret = -ENOMEM;
         goto out;
     }
     
     inode->i_ino = ino;
+    new_nii = NAIVE_I(inode);
+    
+    /* 新目录先以内联方式存放，不分配数据块 */
+    if (naive_has_feature(sbi, NAIVE_FEATURE_INLINE_DATA))
+        new_nii->inline_data = kzalloc(NAIVE_INLINE_SIZE, GFP_KERNEL);
+    if (new_nii->inline_data) {
+        new_nii->i_flags |= NAIVE_INODE_INLINE_DATA;
+        block_no = 0;
+        goto init_inode;
+    }
     
     /* 分配数据块 */
     block_no = naive_alloc_block(sbi);
@@ -191,11 +338,12 @@ int naive_mkdir(struct mnt_idmap *idmap, struct inode *dir,
     mark_buffer_dirty(bh);
     brelse(bh);
     
+init_inode:
     /* 初始化inode */
     inode_init_owner(idmap, inode, dir, S_IFDIR | (mode & 0777));
     inode->i_sb = sb;
     inode->i_op = &naive_dir_iops;
-    inode->i_fop = &simple_dir_operations;
+    inode->i_fop = &naive_dir_ops;
     
     /* 设置时间 */
     struct timespec64 ts;
@@ -207,72 +355,65 @@ int naive_mkdir(struct mnt_idmap *idmap, struct inode *dir,
     /* 设置链接数 */
     set_nlink(inode, 2);
     
-    /* 设置inode大小 */
-    inode->i_size = NAIVE_BLOCK_SIZE;
-    
-    /* 设置块指针 */
-    new_nii = NAIVE_I(inode);
-    new_nii->block_count = 1;
-    new_nii->block_pointers[0] = block_no;
-    
-    /* 标记位图为已使用 */
-    sbi->inode_bitmap[(ino - 1) / 8] |= (1 << ((ino - 1) % 8));
+    /* 设置inode大小和块指针 */
+    if (block_no) {
+        inode->i_size = NAIVE_BLOCK_SIZE;
+        new_nii->block_count = 1;
+        new_nii->block_pointers[0] = block_no;
+        inode_set_bytes(inode, NAIVE_BLOCK_SIZE);
+    } else {
+        inode->i_size = NAIVE_INLINE_SIZE;
+    }
     
     /* 在父目录中添加目录项 */
-    ret = naive_add_entry(dir, dentry, ino);
-    if (ret < 0) {
-        naive_free_block(sbi, block_no);
+    ret = naive_init_security(inode, dir, &dentry->d_name);
+    if (ret == 0)
+        ret = naive_add_entry(dir, dentry, ino);
+    if (ret < 0)
         goto fail_inode;
-    }
     
     /* 更新父目录链接数 */
     inc_nlink(dir);
     mark_inode_dirty(dir);
     
     /* 关联inode和dentry */
+    insert_inode_hash(inode);
     d_instantiate(dentry, inode);
     
-    printk(KERN_INFO "naivefs: directory %s created successfully, inode=%d\n",
-           dentry->d_name.name, ino);
     return 0;
     
 fail_inode:
+    /* 链接数为0，iput经evict_inode释放已分配的块和inode编号 */
+    clear_nlink(inode);
     iput(inode);
 out:
     return ret;
 }
 
-/* 删除目录 */
-int naive_rmdir(struct inode *dir, struct dentry *dentry)
+/* 目录是否为空（.和..不计），空时返回0 */
+static int naive_dir_check_empty(struct inode *inode)
 {
-    struct inode *inode = d_inode(dentry);
-    struct super_block *sb = dir->i_sb;
-    struct naive_sb_info *sbi = NAIVE_SB(sb);
     struct naive_inode_info *nii = NAIVE_I(inode);
+    struct super_block *sb = inode->i_sb;
     struct buffer_head *bh;
     struct naive_dir_record *record;
-    int ret;
     int i, j;
-    int empty = 1;
-    
-    printk(KERN_INFO "naivefs: rmdir called for %s\n", dentry->d_name.name);
     
-    /* 检查是否是目录 */
-    if (!S_ISDIR(inode->i_mode)) {
-        ret = -ENOTDIR;
-        goto out;
+    if (naive_has_inline_data(inode)) {
+        for (j = 0; j < NAIVE_INLINE_DIR_RECORDS; j++) {
+            if (le32_to_cpu(naive_inline_record(inode, j)->i_ino) != 0)
+                return -ENOTEMPTY;
+        }
+        return 0;
     }
     
-    /* 检查目录是否为空 */
     for (i = 0; i < nii->block_count; i++) {
         if (nii->block_pointers[i] == 0)
             continue;
             
         bh = sb_bread(sb, nii->block_pointers[i]);
-        if (!bh) {
-            ret = -EIO;
-            goto out;
-        }
+        if (!bh)
+            return -EIO;
         
         for (j = 0; j < NAIVE_DIR_RECORDS_PER_BLOCK; j++) {
             record = (struct naive_dir_record *)
@@ -287,46 +428,220 @@ int naive_rmdir(struct inode *dir, struct dentry *dentry)
                 
             /* 找到非.和..的目录项，说明目录非空 */
             brelse(bh);
-            ret = -ENOTEMPTY;
-            goto out;
+            return -ENOTEMPTY;
         }
         brelse(bh);
     }
+    return 0;
+}
+
+/* 删除目录 */
+int naive_rmdir(struct inode *dir, struct dentry *dentry)
+{
+    struct inode *inode = d_inode(dentry);
+    int ret;
     
-    /* 从父目录中删除目录项 */
-    ret = naive_remove_entry(dir, dentry);
-    if (ret < 0) {
-        goto out;
-    }
+    /* 检查是否是目录 */
+    if (!S_ISDIR(inode->i_mode))
+        return -ENOTDIR;
     
-    /* 释放目录的数据块 */
-    for (i = 0; i < nii->block_count; i++) {
-        if (nii->block_pointers[i] != 0) {
-            naive_free_block(sbi, nii->block_pointers[i]);
-            nii->block_pointers[i] = 0;
-        }
-    }
-    nii->block_count = 0;
+    /* 检查目录是否为空 */
+    ret = naive_dir_check_empty(inode);
+    if (ret)
+        return ret;
     
-    /* 释放inode位图 */
-    int ino = inode->i_ino;
-    sbi->inode_bitmap[(ino - 1) / 8] &= ~(1 << ((ino - 1) % 8));
+    /* 从父目录中删除目录项 */
+    ret = naive_remove_entry(dir, dentry);
+    if (ret < 0)
+        return ret;
     
     /* 减少父目录链接数 */
     drop_nlink(dir);
+    inode_set_mtime_to_ts(dir, inode_set_ctime_current(dir));
     mark_inode_dirty(dir);
     
-    /* 清除inode */
+    /* 目录的数据块和inode在不再被引用时释放 */
     clear_nlink(inode);
-    inode->i_size = 0;
+    naive_orphan_add(inode);
     
     /* 删除dentry */
     d_drop(dentry);
     
-    printk(KERN_INFO "naivefs: directory %s removed successfully\n",
-           dentry->d_name.name);
     return 0;
+}
+
+/* 创建硬链接：只添加一条指向同一inode的目录项 */
+int naive_link(struct dentry *old_dentry, struct inode *dir,
+              struct dentry *dentry)
+{
+    struct inode *inode = d_inode(old_dentry);
+    int ret;
+    
+    ret = naive_add_entry(dir, dentry, inode->i_ino);
+    if (ret < 0)
+        return ret;
+    
+    inode_set_mtime_to_ts(dir, inode_set_ctime_current(dir));
+    mark_inode_dirty(dir);
+    
+    inode_set_ctime_current(inode);
+    inc_nlink(inode);
+    ihold(inode);
+    mark_inode_dirty(inode);
+    
+    d_instantiate(dentry, inode);
+    return 0;
+}
+
+/* 目录被移到new_dir下：旧格式目录块中的..目录项随之改指新父目录 */
+static int naive_set_dotdot(struct inode *inode, struct inode *new_dir)
+{
+    static const struct qstr dotdot = QSTR_INIT("..", 2);
+    struct naive_dir_slot slot;
+    int ret;
+    
+    /* 内联目录不存放..目录项 */
+    ret = naive_find_entry(inode, &dotdot, &slot);
+    if (ret)
+        return ret == -ENOENT ? 0 : ret;
+    
+    naive_set_entry(inode, &slot, new_dir->i_ino);
+    naive_put_entry(&slot);
+    return 0;
+}
+
+/*
+ * 交换两个目录项：两条目录项各自就地改指对方的inode，不移动数据，
+ * 也不存在某个名字缺失的中间状态。
+ */
+static int naive_rename_exchange(struct inode *old_dir, struct dentry *old_dentry,
+                                 struct inode *new_dir, struct dentry *new_dentry)
+{
+    struct inode *old_inode = d_inode(old_dentry);
+    struct inode *new_inode = d_inode(new_dentry);
+    struct naive_dir_slot old_slot, new_slot;
+    int ret;
+    
+    ret = naive_find_entry(old_dir, &old_dentry->d_name, &old_slot);
+    if (ret)
+        return ret;
+    ret = naive_find_entry(new_dir, &new_dentry->d_name, &new_slot);
+    if (ret) {
+        naive_put_entry(&old_slot);
+        return ret;
+    }
+    
+    naive_set_entry(old_dir, &old_slot, new_inode->i_ino);
+    naive_set_entry(new_dir, &new_slot, old_inode->i_ino);
+    naive_put_entry(&old_slot);
+    naive_put_entry(&new_slot);
+    
+    /* 只有一方是目录且跨目录交换时，父目录的链接数随之转移 */
+    if (old_dir != new_dir) {
+        if (S_ISDIR(old_inode->i_mode)) {
+            naive_set_dotdot(old_inode, new_dir);
+            if (!S_ISDIR(new_inode->i_mode)) {
+                drop_nlink(old_dir);
+                inc_nlink(new_dir);
+            }
+        }
+        if (S_ISDIR(new_inode->i_mode)) {
+            naive_set_dotdot(new_inode, old_dir);
+            if (!S_ISDIR(old_inode->i_mode)) {
+                drop_nlink(new_dir);
+                inc_nlink(old_dir);
+            }
+        }
+    }
+    
+    inode_set_ctime_current(old_inode);
+    inode_set_ctime_current(new_inode);
+    mark_inode_dirty(old_inode);
+    mark_inode_dirty(new_inode);
+    return 0;
+}
+
+/*
+ * 重命名。目标已存在时就地把目标目录项改指源inode，替换只写一条目录项，
+ * 目标名字始终存在；否则先在新目录中添加目录项，再删除旧目录项，中途
+ * 崩溃最多多出一个链接而不会丢失文件。两种情况都不复制数据。
+ */
+int naive_rename(struct mnt_idmap *idmap, struct inode *old_dir,
+                struct dentry *old_dentry, struct inode *new_dir,
+                struct dentry *new_dentry, unsigned int flags)
+{
+    struct inode *old_inode = d_inode(old_dentry);
+    struct inode *new_inode = d_inode(new_dentry);
+    bool is_dir = S_ISDIR(old_inode->i_mode);
+    struct naive_dir_slot slot;
+    struct timespec64 now;
+    int ret;
+    
+    /* RENAME_NOREPLACE时目标存在的情况已由VFS拒绝 */
+    if (flags & ~(RENAME_NOREPLACE | RENAME_EXCHANGE))
+        return -EINVAL;
+    
+    if (flags & RENAME_EXCHANGE) {
+        ret = naive_rename_exchange(old_dir, old_dentry, new_dir, new_dentry);
+        if (ret)
+            return ret;
+        goto out;
+    }
+    
+    if (new_inode) {
+        if (is_dir) {
+            ret = naive_dir_check_empty(new_inode);
+            if (ret)
+                return ret;
+        }
+        
+        ret = naive_find_entry(new_dir, &new_dentry->d_name, &slot);
+        if (ret)
+            return ret;
+        naive_set_entry(new_dir, &slot, old_inode->i_ino);
+        naive_put_entry(&slot);
+    } else {
+        ret = naive_add_entry(new_dir, new_dentry, old_inode->i_ino);
+        if (ret < 0)
+            return ret;
+    }
+    
+    ret = naive_remove_entry(old_dir, old_dentry);
+    if (ret)
+        return ret;
+    
+    if (is_dir && old_dir != new_dir) {
+        naive_set_dotdot(old_inode, new_dir);
+        drop_nlink(old_dir);
+        if (!new_inode)
+            inc_nlink(new_dir);
+    } else if (is_dir && new_inode) {
+        /* 被替换的目录原本占用的一个父目录链接 */
+        drop_nlink(new_dir);
+    }
+    
+    /* 被替换的目标少了一个链接，最后一个链接消失时加入孤儿链表 */
+    if (new_inode) {
+        inode_set_ctime_current(new_inode);
+        if (is_dir)
+            clear_nlink(new_inode);
+        else
+            drop_nlink(new_inode);
+        if (!new_inode->i_nlink)
+            naive_orphan_add(new_inode);
+        mark_inode_dirty(new_inode);
+    }
+    
+    inode_set_ctime_current(old_inode);
+    mark_inode_dirty(old_inode);
     
 out:
-    return ret;
+    now = inode_set_ctime_current(old_dir);
+    inode_set_mtime_to_ts(old_dir, now);
+    mark_inode_dirty(old_dir);
+    if (new_dir != old_dir) {
+        inode_set_mtime_to_ts(new_dir, inode_set_ctime_to_ts(new_dir, now));
+        mark_inode_dirty(new_dir);
+    }
+    return 0;
 }
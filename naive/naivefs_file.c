@@ -2,155 +2,1710 @@
 
 #include <linux/pagemap.h>
 #include <linux/uio.h>
+#include <linux/iomap.h>
+#include <linux/blkdev.h>
+#include <linux/bio.h>
+#include <linux/splice.h>
+
+#include "trace/events/naivefs.h"
+
+/* ra=<blocks>换算成页，0表示关闭预读 */
+static unsigned int naive_ra_max_pages(struct super_block *sb)
+{
+    return DIV_ROUND_UP(NAIVE_SB(sb)->opts.ra_blocks * NAIVE_BLOCK_SIZE, PAGE_SIZE);
+}
 
 /* 文件打开函数 */
 int naive_file_open(struct inode *inode, struct file *filp)
 {
-    printk(KERN_INFO "naivefs: file_open called for inode %lu\n", inode->i_ino);
+    struct naive_file_info *nfi;
+    
+    nfi = kzalloc(sizeof(struct naive_file_info), GFP_KERNEL);
+    if (!nfi)
+        return -ENOMEM;
+    nfi->ra_window = min(naive_ra_max_pages(inode->i_sb), NAIVE_RA_MIN_PAGES);
+    filp->private_data = nfi;
+    
+    /* 读写路径支持IOCB_NOWAIT，io_uring可直接在提交上下文完成缓存命中的I/O */
+    filp->f_mode |= FMODE_NOWAIT;
+    filp->f_ra.ra_pages = nfi->ra_window;
     return 0;
 }
 
 /* 文件释放函数 */
 int naive_file_release(struct inode *inode, struct file *filp)
 {
-    printk(KERN_INFO "naivefs: file_release called for inode %lu\n", inode->i_ino);
+    kfree(filp->private_data);
     return 0;
 }
 
-/* 文件读取函数 */
-ssize_t naive_file_read(struct file *filp, char __user *buf, size_t len, loff_t *pos)
+/*
+ * 自适应预读：从上次读结束的位置继续读视为顺序读，窗口翻倍直到ra=<blocks>
+ * 的上限；否则视为随机读，窗口缩回到本次请求的大小，不再多读。
+ * 页缓存在f_ra.ra_pages范围内发起预读，iomap_readahead把物理连续的块
+ * 合并成一个bio。多个线程共用同一个file时这里的竞争只影响预读效果。
+ */
+static void naive_file_ra_update(struct kiocb *iocb, size_t len)
+{
+    struct file *filp = iocb->ki_filp;
+    struct naive_file_info *nfi = filp->private_data;
+    struct naive_sb_info *sbi = NAIVE_SB(file_inode(filp)->i_sb);
+    unsigned int max_pages = naive_ra_max_pages(file_inode(filp)->i_sb);
+    unsigned int req_pages = DIV_ROUND_UP(len, PAGE_SIZE);
+    
+    if (iocb->ki_pos == nfi->ra_next) {
+        nfi->ra_window = min(max(nfi->ra_window * 2, NAIVE_RA_MIN_PAGES), max_pages);
+        naive_stat_inc(sbi, NAIVE_STAT_RA_SEQUENTIAL);
+    } else {
+        nfi->ra_window = min(req_pages, max_pages);
+        naive_stat_inc(sbi, NAIVE_STAT_RA_RANDOM);
+    }
+    nfi->ra_next = iocb->ki_pos + len;
+    
+    /* fadvise(POSIX_FADV_RANDOM)等已由页缓存自行处理 */
+    if (!(filp->f_mode & FMODE_RANDOM))
+        filp->f_ra.ra_pages = nfi->ra_window;
+}
+
+/* 按atime=<mode>更新访问时间，由file_accessed()经touch_atime()调用 */
+int naive_update_time(struct inode *inode, int flags)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    
+    if (flags & S_ATIME) {
+        if (sbi->opts.atime_mode == NAIVE_ATIME_NONE) {
+            flags &= ~S_ATIME;
+        } else if (sbi->opts.atime_mode == NAIVE_ATIME_LAZY &&
+                   !(flags & ~S_ATIME)) {
+            /* 只更新内存，随inode的其他修改一起落盘 */
+            inode_set_atime_to_ts(inode, current_time(inode));
+            return 0;
+        }
+    }
+    
+    if (!flags)
+        return 0;
+    return generic_update_time(inode, flags);
+}
+
+/*
+ * 释放[first, first + count)中已分配的块，成为空洞。物理上连续的
+ * 一段交给分配器一次释放，减少位图锁的往返。
+ */
+static void naive_free_block_range(struct inode *inode, sector_t first,
+                                   sector_t count)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    sector_t blk = first;
+    sector_t end;
+    
+    mutex_lock(&nii->block_lock);
+    end = min_t(sector_t, first + count, nii->block_count);
+    while (blk < end) {
+        unsigned int n = 1, i;
+        u32 ptr, start;
+        
+        if (naive_bmap_read(inode, blk, &ptr) || !ptr) {
+            blk++;
+            continue;
+        }
+        start = NAIVE_BLOCK_NO(ptr);
+        while (blk + n < end && !naive_bmap_read(inode, blk + n, &ptr) &&
+               NAIVE_BLOCK_NO(ptr) == start + n)
+            n++;
+        
+        naive_free_blocks(sbi, start, n);
+        inode_sub_bytes(inode, (loff_t)n << inode->i_blkbits);
+        for (i = 0; i < n; i++)
+            naive_bmap_write(inode, blk + i, 0);
+        blk += n;
+    }
+    /* 末尾的空洞不计入block_count */
+    while (nii->block_count > 0) {
+        u32 ptr;
+        
+        if (naive_bmap_read(inode, nii->block_count - 1, &ptr) || ptr)
+            break;
+        nii->block_count--;
+    }
+    mutex_unlock(&nii->block_lock);
+    mark_inode_dirty(inode);
+}
+
+/* 释放文件内从first_block开始的所有块，包括不再需要的间接块 */
+void naive_free_blocks_from(struct inode *inode, sector_t first_block)
+{
+    if (first_block < NAIVE_MAX_BLOCKS)
+        naive_free_block_range(inode, first_block,
+                               NAIVE_MAX_BLOCKS - first_block);
+}
+
+/*
+ * 从文件末尾释放最多count块，返回剩下的块数。后台回收已删除的大文件时
+ * 分批调用，每批只持有一次block_lock，期间其他文件仍可分配块。
+ */
+sector_t naive_free_tail_blocks(struct inode *inode, sector_t count)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    sector_t first;
+    
+    mutex_lock(&nii->block_lock);
+    first = nii->block_count > count ? nii->block_count - count : 0;
+    mutex_unlock(&nii->block_lock);
+    
+    naive_free_blocks_from(inode, first);
+    return first;
+}
+
+/*
+ * 为空洞[first, first + count)分配块，每次从前一块之后连续分配尽可能长
+ * 的一段，使文件在磁盘上保持连续；跨间接块时先分配间接块。flags为
+ * NAIVE_BLOCK_UNWRITTEN时新块标记为未写入，读出为0，直到第一次写入后
+ * 才转换。范围之前的空洞保持为空洞，不分配块。调用者持有block_lock。
+ */
+static int naive_file_fill_blocks(struct inode *inode, sector_t first,
+                                  sector_t count, u32 flags)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    sector_t blk = first, end = first + count;
+    
+    if (end > NAIVE_MAX_BLOCKS)
+        return -EFBIG;
+    
+    while (blk < end) {
+        unsigned long goal = 0;
+        u32 start, prev;
+        int n, i, ret;
+        
+        if (blk > 0 && !naive_bmap_read(inode, blk - 1, &prev) && prev)
+            goal = NAIVE_BLOCK_NO(prev) + 1;
+        ret = naive_bmap_reserve(inode, blk, goal);
+        if (ret)
+            return ret;
+        
+        n = naive_alloc_blocks(sbi, goal, min(end - blk, naive_bmap_span(blk)),
+                               &start);
+        if (n < 0) {
+            naive_bmap_unreserve(inode, blk);
+            return n;
+        }
+        
+        /* 间接块已存在，设置指针不会失败 */
+        for (i = 0; i < n; i++)
+            naive_bmap_write(inode, blk + i, (start + i) | flags);
+        blk += n;
+        inode_add_bytes(inode, (loff_t)n << inode->i_blkbits);
+        mark_inode_dirty(inode);
+    }
+    return 0;
+}
+
+/* ========== 内联数据 ========== */
+
+/* 同步读写从bno开始的count个块，数据在page中 */
+static int naive_rw_blocks(struct super_block *sb, blk_opf_t opf, u32 bno,
+                           unsigned int count, struct page *page)
+{
+    struct bio *bio;
+    int ret;
+    
+    bio = bio_alloc(sb->s_bdev, 1, opf, GFP_NOFS);
+    bio->bi_iter.bi_sector = (sector_t)bno << (sb->s_blocksize_bits - SECTOR_SHIFT);
+    __bio_add_page(bio, page, count << sb->s_blocksize_bits, 0);
+    ret = submit_bio_wait(bio);
+    bio_put(bio);
+    return ret;
+}
+
+/*
+ * 把内联数据搬到新分配的数据块中，之后按普通文件处理。inline_data
+ * 保留到inode销毁，并发读者可能仍持有它。调用者持有block_lock。
+ */
+static int naive_inline_to_blocks(struct inode *inode)
 {
-    struct inode *inode = file_inode(filp);
     struct naive_inode_info *nii = NAIVE_I(inode);
     struct super_block *sb = inode->i_sb;
-    struct buffer_head *bh;
-    ssize_t ret = 0;
-    size_t remaining;
-    int block_index;
+    struct page *page;
+    int bno;
+    int ret;
     
-    printk(KERN_INFO "naivefs: file_read called for inode %lu, len=%zu, pos=%lld\n",
-           inode->i_ino, len, *pos);
+    if (!naive_has_inline_data(inode))
+        return 0;
     
-    /* 检查边界 */
-    if (*pos >= inode->i_size)
+    /* 空文件不需要数据块 */
+    if (i_size_read(inode) > 0) {
+        page = alloc_page(GFP_NOFS | __GFP_ZERO);
+        if (!page)
+            return -ENOMEM;
+        bno = naive_alloc_block(NAIVE_SB(sb));
+        if (bno < 0) {
+            __free_page(page);
+            return bno;
+        }
+        
+        /* 内联区中i_size之后的部分始终为0 */
+        memcpy(page_address(page), nii->inline_data, NAIVE_INLINE_SIZE);
+        ret = naive_rw_blocks(sb, REQ_OP_WRITE, bno, 1, page);
+        __free_page(page);
+        if (ret) {
+            naive_free_block(NAIVE_SB(sb), bno);
+            return ret;
+        }
+        
+        nii->block_pointers[0] = bno;
+        nii->block_count = 1;
+        inode_add_bytes(inode, i_blocksize(inode));
+    }
+    
+    nii->i_flags &= ~NAIVE_INODE_INLINE_DATA;
+    mark_inode_dirty(inode);
+    return 0;
+}
+
+/* 需要按块访问文件之前调用（reflink、fallocate等） */
+static int naive_inline_convert(struct inode *inode)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    int ret;
+    
+    if (!naive_has_inline_data(inode))
         return 0;
     
-    remaining = min_t(size_t, len, inode->i_size - *pos);
+    mutex_lock(&nii->block_lock);
+    ret = naive_inline_to_blocks(inode);
+    mutex_unlock(&nii->block_lock);
+    return ret;
+}
+
+/*
+ * 内联文件的映射：读返回[0, i_size)的IOMAP_INLINE，之后是空洞；能放进内联区
+ * 的缓冲写返回整个内联区，iomap_write_end()把页中的数据复制回inline_data。
+ * 放不下的写、直接I/O写和mmap写先转换为普通文件。返回1表示调用者应按块
+ * 映射。调用者持有block_lock。
+ */
+static int naive_iomap_inline(struct inode *inode, loff_t offset, loff_t length,
+                              unsigned int flags, struct iomap *iomap)
+{
+    loff_t size = i_size_read(inode);
+    int ret;
+    
+    if (!naive_has_inline_data(inode))
+        return 1;
     
-    /* 逐块读取 */
-    while (remaining > 0) {
-        block_index = *pos / NAIVE_BLOCK_SIZE;
-        if (block_index >= nii->block_count || nii->block_pointers[block_index] == 0)
+    if (flags & IOMAP_WRITE) {
+        if (offset + length > NAIVE_INLINE_SIZE ||
+            (flags & (IOMAP_DIRECT | IOMAP_FAULT))) {
+            if (flags & IOMAP_NOWAIT)
+                return -EAGAIN;
+            ret = naive_inline_to_blocks(inode);
+            return ret ? ret : 1;
+        }
+        size = NAIVE_INLINE_SIZE;
+    }
+    
+    iomap->flags = 0;
+    iomap->bdev = inode->i_sb->s_bdev;
+    iomap->addr = IOMAP_NULL_ADDR;
+    if (offset >= size) {
+        iomap->type = IOMAP_HOLE;
+        iomap->offset = offset;
+        iomap->length = length;
+    } else {
+        iomap->type = IOMAP_INLINE;
+        iomap->inline_data = NAIVE_I(inode)->inline_data;
+        iomap->offset = 0;
+        iomap->length = size;
+    }
+    return 0;
+}
+
+static int __naive_get_block(struct inode *inode, sector_t iblock,
+                             unsigned int max_blocks, int create,
+                             u32 *bno, bool *new)
+{
+    unsigned int count = 1;
+    u32 ptr;
+    int ret;
+    
+    *bno = 0;
+    *new = false;
+    
+    if (create && naive_has_inline_data(inode)) {
+        ret = naive_inline_to_blocks(inode);
+        if (ret)
+            return ret;
+    }
+    
+    if (iblock >= NAIVE_MAX_BLOCKS)
+        return create ? -EFBIG : max_blocks;
+    
+    max_blocks = min_t(sector_t, max_blocks, NAIVE_MAX_BLOCKS - iblock);
+    
+    ret = naive_bmap_read(inode, iblock, &ptr);
+    if (ret)
+        return ret;
+    
+    if (!ptr) {
+        while (count < max_blocks) {
+            ret = naive_bmap_read(inode, iblock + count, &ptr);
+            if (ret)
+                return ret;
+            if (ptr)
+                break;
+            count++;
+        }
+        if (!create)
+            return count;
+        
+        ret = naive_file_fill_blocks(inode, iblock, count,
+                (create & NAIVE_GET_BLOCK_UNWRITTEN) ? NAIVE_BLOCK_UNWRITTEN : 0);
+        if (ret < 0)
+            return ret;
+        *new = true;
+        count = 1;
+        naive_bmap_read(inode, iblock, &ptr);
+    }
+    
+    /* 块号和未写入标志都相同的连续块才合并成一段 */
+    *bno = ptr;
+    while (count < max_blocks) {
+        if (naive_bmap_read(inode, iblock + count, &ptr) || ptr != *bno + count)
             break;
+        count++;
+    }
+    return count;
+}
+
+/*
+ * 块映射：从文件内第iblock块开始最多映射max_blocks块。
+ * 返回映射的块数，*bno为起始块指针（可能带NAIVE_BLOCK_UNWRITTEN）；
+ * *bno为0表示空洞，返回值为空洞长度。
+ * 物理上连续的块一次返回，使iomap能把它们合并成一个bio。
+ */
+int naive_get_block(struct inode *inode, sector_t iblock,
+                    unsigned int max_blocks, int create,
+                    u32 *bno, bool *new)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    int ret;
+    
+    if (create & NAIVE_GET_BLOCK_NOWAIT) {
+        if (!mutex_trylock(&nii->block_lock))
+            return -EAGAIN;
+        create &= ~NAIVE_GET_BLOCK_NOWAIT;
+    } else {
+        mutex_lock(&nii->block_lock);
+    }
+    ret = __naive_get_block(inode, iblock, max_blocks, create, bno, new);
+    mutex_unlock(&nii->block_lock);
+    return ret;
+}
+
+/* 数据已写入：清除[iblock, iblock + count)的未写入标志 */
+static void naive_convert_unwritten(struct inode *inode, sector_t iblock,
+                                    sector_t count)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    bool dirty = false;
+    sector_t blk;
+    
+    mutex_lock(&nii->block_lock);
+    for (blk = iblock; blk < iblock + count && blk < nii->block_count; blk++) {
+        u32 ptr;
         
-        bh = sb_bread(sb, nii->block_pointers[block_index]);
-        if (!bh) {
-            ret = -EIO;
+        if (naive_bmap_read(inode, blk, &ptr))
             break;
+        if (ptr & NAIVE_BLOCK_UNWRITTEN) {
+            naive_bmap_write(inode, blk, ptr & ~NAIVE_BLOCK_UNWRITTEN);
+            dirty = true;
         }
+    }
+    mutex_unlock(&nii->block_lock);
+    if (dirty)
+        mark_inode_dirty(inode);
+}
+
+/*
+ * 写时复制：把[iblock, iblock + count)中与其他文件共享的块换成新分配的块，
+ * 旧块的引用计数减一。调用者保证这些块随后会被整块复制，因此不需要
+ * 复制旧内容。回写不走这里，见naive_map_cow_blocks。
+ */
+static int naive_unshare_blocks(struct inode *inode, sector_t iblock,
+                                unsigned int count)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    unsigned int i;
+    int ret = 0;
+    
+    if (!sbi->refcount)
+        return 0;
+    
+    mutex_lock(&nii->block_lock);
+    for (i = 0; i < count && iblock + i < nii->block_count; i++) {
+        sector_t blk = iblock + i;
+        unsigned long goal = 0;
+        bool shared;
+        u32 old, prev, bno;
         
-        size_t offset_in_block = *pos % NAIVE_BLOCK_SIZE;
-        size_t to_copy = min_t(size_t, remaining, NAIVE_BLOCK_SIZE - offset_in_block);
+        ret = naive_bmap_read(inode, blk, &old);
+        if (ret)
+            break;
+        old = NAIVE_BLOCK_NO(old);
+        if (!old)
+            continue;
+        naive_shared_extent(sbi, old, 1, &shared);
+        if (!shared)
+            continue;
         
-        if (copy_to_user(buf + ret, bh->b_data + offset_in_block, to_copy)) {
-            brelse(bh);
-            ret = -EFAULT;
+        if (blk > 0 && !naive_bmap_read(inode, blk - 1, &prev) && prev)
+            goal = NAIVE_BLOCK_NO(prev) + 1;
+        ret = naive_alloc_blocks(sbi, goal, 1, &bno);
+        if (ret < 0)
+            break;
+        
+        /* 新块会被整块写入，不再是未写入状态；间接块已存在 */
+        ret = naive_bmap_write(inode, blk, bno);
+        if (ret) {
+            naive_free_block(sbi, bno);
             break;
         }
+        naive_free_block(sbi, old);
+        mark_inode_dirty(inode);
+    }
+    mutex_unlock(&nii->block_lock);
+    return ret;
+}
+
+static int naive_iomap_begin(struct inode *inode, loff_t offset, loff_t length,
+                             unsigned int flags, struct iomap *iomap,
+                             struct iomap *srcmap)
+{
+    unsigned int blkbits = inode->i_blkbits;
+    sector_t iblock = offset >> blkbits;
+    u64 end_block = DIV_ROUND_UP_ULL(offset + length, i_blocksize(inode));
+    unsigned int max_blocks = min_t(u64, end_block - iblock, UINT_MAX);
+    bool write = flags & IOMAP_WRITE;
+    bool nowait = flags & IOMAP_NOWAIT;
+    bool new;
+    u32 bno;
+    int ret;
+    
+    if (naive_has_inline_data(inode)) {
+        struct naive_inode_info *nii = NAIVE_I(inode);
         
-        brelse(bh);
+        if (!nowait)
+            mutex_lock(&nii->block_lock);
+        else if (!mutex_trylock(&nii->block_lock))
+            return -EAGAIN;
+        ret = naive_iomap_inline(inode, offset, length, flags, iomap);
+        mutex_unlock(&nii->block_lock);
+        if (ret <= 0)
+            return ret;
+    }
+    
+    ret = naive_get_block(inode, iblock, max_blocks,
+                          nowait ? NAIVE_GET_BLOCK_NOWAIT :
+                          write ? NAIVE_GET_BLOCK_CREATE : 0, &bno, &new);
+    if (ret < 0)
+        return ret;
+    
+    /* NOWAIT写遇到空洞需要分配，不能在当前上下文完成 */
+    if (write && nowait && !bno)
+        return -EAGAIN;
+    
+    iomap->flags = 0;
+    
+    if (bno) {
+        bool shared;
         
-        *pos += to_copy;
-        remaining -= to_copy;
-        ret += to_copy;
+        /* 一个映射内的块要么都共享、要么都不共享 */
+        ret = naive_shared_extent(NAIVE_SB(inode->i_sb), NAIVE_BLOCK_NO(bno),
+                                  ret, &shared);
+        if (shared) {
+            /*
+             * 共享块不能就地写。缓冲写只修改页缓存，由回写时的写时复制
+             * 换成新块；直接I/O返回-ENOTBLK，回退到缓冲写。
+             */
+            if (write && (flags & IOMAP_DIRECT))
+                return -ENOTBLK;
+            iomap->flags |= IOMAP_F_SHARED;
+        }
+    }
+    
+    iomap->bdev = inode->i_sb->s_bdev;
+    iomap->offset = (u64)iblock << blkbits;
+    iomap->length = (u64)ret << blkbits;
+    
+    if (!bno) {
+        iomap->type = IOMAP_HOLE;
+        iomap->addr = IOMAP_NULL_ADDR;
+    } else {
+        /* 未写入块读出为0；写入后由直接I/O完成回调或回写转换 */
+        if (bno & NAIVE_BLOCK_UNWRITTEN)
+            iomap->type = IOMAP_UNWRITTEN;
+        else
+            iomap->type = IOMAP_MAPPED;
+        iomap->addr = (u64)NAIVE_BLOCK_NO(bno) << blkbits;
+        if (new)
+            iomap->flags |= IOMAP_F_NEW;
     }
+    return 0;
+}
+
+static int naive_iomap_end(struct inode *inode, loff_t offset, loff_t length,
+                           ssize_t written, unsigned int flags,
+                           struct iomap *iomap)
+{
+    /* iomap_write_end()只更新i_size，由这里负责标记inode为脏 */
+    if (iomap->flags & IOMAP_F_SIZE_CHANGED)
+        mark_inode_dirty(inode);
+    
+    /* 短写：释放本次新分配、但落在文件末尾之后的块 */
+    if ((flags & IOMAP_WRITE) && (iomap->flags & IOMAP_F_NEW) &&
+        written < length) {
+        loff_t end = max_t(loff_t, i_size_read(inode), offset + written);
+        
+        naive_free_blocks_from(inode, DIV_ROUND_UP(end, NAIVE_BLOCK_SIZE));
+    }
+    return 0;
+}
+
+const struct iomap_ops naive_iomap_ops = {
+    .iomap_begin    = naive_iomap_begin,
+    .iomap_end      = naive_iomap_end,
+};
+
+/* 直接I/O写完成：转换写入的未写入块，扩展了文件时更新i_size */
+static int naive_dio_write_end_io(struct kiocb *iocb, ssize_t size,
+                                  int error, unsigned int flags)
+{
+    struct inode *inode = file_inode(iocb->ki_filp);
+    loff_t end = iocb->ki_pos + size;
+    
+    if (error || size <= 0)
+        return error;
+    
+    if (flags & IOMAP_DIO_UNWRITTEN)
+        naive_convert_unwritten(inode, iocb->ki_pos >> inode->i_blkbits,
+                                DIV_ROUND_UP(end, i_blocksize(inode)) -
+                                (iocb->ki_pos >> inode->i_blkbits));
+    
+    if (end > i_size_read(inode)) {
+        i_size_write(inode, end);
+        mark_inode_dirty(inode);
+    }
+    return 0;
+}
+
+static const struct iomap_dio_ops naive_dio_write_ops = {
+    .end_io     = naive_dio_write_end_io,
+};
+
+/* O_DIRECT：偏移、长度和用户缓冲区都必须按块大小对齐 */
+static bool naive_dio_aligned(struct kiocb *iocb, struct iov_iter *iter)
+{
+    unsigned int mask = i_blocksize(file_inode(iocb->ki_filp)) - 1;
+    
+    return !((iocb->ki_pos | iov_iter_count(iter) | iov_iter_alignment(iter)) & mask);
+}
+
+/*
+ * 直接写遇到共享块时的剩余部分：经页缓存写入后立即写回并丢弃缓存页，
+ * 对调用者而言仍是O_DIRECT语义。done为直接I/O已完成的字节数。
+ */
+static ssize_t naive_dio_fallback_write(struct kiocb *iocb, struct iov_iter *from,
+                                        ssize_t done)
+{
+    struct address_space *mapping = iocb->ki_filp->f_mapping;
+    loff_t pos = iocb->ki_pos;
+    ssize_t written;
+    int err;
+    
+    written = iomap_file_buffered_write(iocb, from, &naive_iomap_ops, NULL);
+    if (written <= 0)
+        return done ? done : written;
     
+    err = filemap_write_and_wait_range(mapping, pos, pos + written - 1);
+    if (err)
+        return done ? done : err;
+    invalidate_mapping_pages(mapping, pos >> PAGE_SHIFT,
+                             (pos + written - 1) >> PAGE_SHIFT);
+    return done + written;
+}
+
+/* 文件读取函数 */
+ssize_t naive_file_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+    struct inode *inode = file_inode(iocb->ki_filp);
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    size_t len = iov_iter_count(to);
+    loff_t start = iocb->ki_pos;
+    u64 start_ns = ktime_get_ns();
+    ssize_t ret;
+    
+    if (iocb->ki_flags & IOCB_DIRECT) {
+        if (!naive_dio_aligned(iocb, to)) {
+            ret = -EINVAL;
+            goto out;
+        }
+        if (iocb->ki_flags & IOCB_NOWAIT) {
+            if (!inode_trylock_shared(inode)) {
+                ret = -EAGAIN;
+                goto out;
+            }
+        } else {
+            inode_lock_shared(inode);
+        }
+        ret = iomap_dio_rw(iocb, to, &naive_iomap_ops, NULL, 0, NULL, 0);
+        inode_unlock_shared(inode);
+        file_accessed(iocb->ki_filp);
+    } else {
+        /* 页缓存路径：iomap_read_folio/iomap_readahead负责实际读盘 */
+        naive_file_ra_update(iocb, len);
+        ret = generic_file_read_iter(iocb, to);
+    }
+    
+    if (ret > 0)
+        naive_stat_add(sbi, NAIVE_STAT_BYTES_READ, ret);
+    
+out:
+    naive_stat_latency(sbi, NAIVE_LAT_READ, start_ns);
+    trace_naivefs_file_read(inode, start, len, ret);
     return ret;
 }
 
 /* 文件写入函数 */
-ssize_t naive_file_write(struct file *filp, const char __user *buf, size_t len, loff_t *pos)
+ssize_t naive_file_write_iter(struct kiocb *iocb, struct iov_iter *from)
 {
-    struct inode *inode = file_inode(filp);
-    struct naive_inode_info *nii = NAIVE_I(inode);
+    struct file *file = iocb->ki_filp;
+    struct inode *inode = file_inode(file);
     struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
-    struct buffer_head *bh;
-    ssize_t ret = 0;
-    size_t remaining = len;
-    int block_index;
+    size_t len = iov_iter_count(from);
+    loff_t start = iocb->ki_pos;
+    u64 start_ns = ktime_get_ns();
+    struct blk_plug plug;
+    ssize_t ret;
     
-    printk(KERN_INFO "naivefs: file_write called for inode %lu, len=%zu, pos=%lld\n",
-           inode->i_ino, len, *pos);
+    if (iocb->ki_flags & IOCB_NOWAIT) {
+        if (!inode_trylock(inode)) {
+            ret = -EAGAIN;
+            goto out;
+        }
+    } else {
+        inode_lock(inode);
+    }
     
-    /* 检查文件大小限制 */
-    if (*pos + len > NAIVE_MAX_FILE_SIZE)
-        return -EFBIG;
+    /* 清零、写入和O_SYNC回写产生的bio在plug中合并后一起下发 */
+    blk_start_plug(&plug);
     
-    /* 需要分配新的块吗？ */
-    if (*pos + len > inode->i_size) {
-        int needed_blocks = ((*pos + len + NAIVE_BLOCK_SIZE - 1) / NAIVE_BLOCK_SIZE) -
-                           (inode->i_size / NAIVE_BLOCK_SIZE);
-        
-        for (int i = 0; i < needed_blocks; i++) {
-            int new_block = naive_alloc_block(sbi);
-            if (new_block < 0) {
-                ret = -ENOSPC;
-                goto out;
-            }
-            
-            if (nii->block_count < NAIVE_BLOCK_PER_FILE) {
-                nii->block_pointers[nii->block_count++] = new_block;
-            } else {
-                naive_free_block(sbi, new_block);
-                ret = -ENOSPC;
-                goto out;
-            }
+    /* O_APPEND、RLIMIT_FSIZE和s_maxbytes检查 */
+    ret = generic_write_checks(iocb, from);
+    if (ret <= 0)
+        goto unlock;
+    start = iocb->ki_pos;
+    
+    /* 越过文件末尾需要先清零，可能分配块并等待I/O */
+    if ((iocb->ki_flags & IOCB_NOWAIT) && iocb->ki_pos > i_size_read(inode)) {
+        ret = -EAGAIN;
+        goto unlock;
+    }
+    
+    /* 清除setuid位并更新时间；NOWAIT时需要标记inode为脏则返回-EAGAIN */
+    ret = kiocb_modified(iocb);
+    if (ret)
+        goto unlock;
+    
+    /* 在文件末尾之后写：先把原末尾块的剩余部分清零 */
+    if (iocb->ki_pos > i_size_read(inode)) {
+        ret = iomap_zero_range(inode, i_size_read(inode),
+                               iocb->ki_pos - i_size_read(inode),
+                               NULL, &naive_iomap_ops);
+        if (ret)
+            goto unlock;
+    }
+    
+    if (iocb->ki_flags & IOCB_DIRECT) {
+        if (!naive_dio_aligned(iocb, from)) {
+            ret = -EINVAL;
+            goto unlock;
         }
+        ret = iomap_dio_rw(iocb, from, &naive_iomap_ops,
+                           &naive_dio_write_ops, 0, NULL, 0);
+        if (ret == -ENOTBLK)
+            ret = 0;
+        if (ret >= 0 && iov_iter_count(from))
+            ret = naive_dio_fallback_write(iocb, from, ret);
+    } else {
+        ret = iomap_file_buffered_write(iocb, from, &naive_iomap_ops, NULL);
+    }
+    
+unlock:
+    inode_unlock(inode);
+    
+    if (ret > 0) {
+        naive_stat_add(sbi, NAIVE_STAT_BYTES_WRITTEN, ret);
+        ret = generic_write_sync(iocb, ret);
+    }
+    blk_finish_plug(&plug);
+    
+out:
+    naive_stat_latency(sbi, NAIVE_LAT_WRITE, start_ns);
+    trace_naivefs_file_write(inode, start, len, ret);
+    return ret;
+}
+
+/* ========== 文件内复制 ========== */
+
+/* 一次拷贝最多使用一个页作为中转缓冲 */
+#define NAIVE_COPY_BLOCKS (PAGE_SIZE / NAIVE_BLOCK_SIZE)
+
+/*
+ * 在块设备上把源文件的nr_blocks个整块复制到目标文件，不经过用户空间。
+ * 调用者持有两个inode的锁，且两边的页缓存已写回。返回复制的块数。
+ */
+static ssize_t naive_copy_blocks(struct inode *src, sector_t src_blk,
+                                 struct inode *dst, sector_t dst_blk,
+                                 sector_t nr_blocks)
+{
+    struct super_block *sb = src->i_sb;
+    struct page *page;
+    sector_t done = 0;
+    int ret = 0;
+    
+    page = alloc_page(GFP_NOFS);
+    if (!page)
+        return -ENOMEM;
+    
+    /* 目标块会被整块覆盖，共享的先换成新块 */
+    ret = naive_unshare_blocks(dst, dst_blk, nr_blocks);
+    if (ret) {
+        __free_page(page);
+        return ret;
     }
     
-    /* 逐块写入 */
-    while (remaining > 0) {
-        block_index = *pos / NAIVE_BLOCK_SIZE;
-        if (block_index >= nii->block_count) {
-            ret = -ENOSPC;
+    while (done < nr_blocks) {
+        unsigned int want = min_t(sector_t, nr_blocks - done, NAIVE_COPY_BLOCKS);
+        u32 sbno, dbno;
+        bool new;
+        int n, m;
+        
+        n = naive_get_block(src, src_blk + done, want, 0, &sbno, &new);
+        if (n < 0) {
+            ret = n;
+            break;
+        }
+        m = naive_get_block(dst, dst_blk + done, n, NAIVE_GET_BLOCK_CREATE,
+                            &dbno, &new);
+        if (m < 0) {
+            ret = m;
             break;
         }
         
-        bh = sb_bread(inode->i_sb, nii->block_pointers[block_index]);
-        if (!bh) {
-            ret = -EIO;
+        if (!sbno || (sbno & NAIVE_BLOCK_UNWRITTEN)) {
+            /* 源文件的空洞或未写入块：目标块清零 */
+            ret = sb_issue_zeroout(sb, NAIVE_BLOCK_NO(dbno), m, GFP_NOFS);
+        } else {
+            ret = naive_rw_blocks(sb, REQ_OP_READ, sbno, m, page);
+            if (!ret)
+                ret = naive_rw_blocks(sb, REQ_OP_WRITE, NAIVE_BLOCK_NO(dbno),
+                                      m, page);
+        }
+        if (ret)
+            break;
+        naive_convert_unwritten(dst, dst_blk + done, m);
+        done += m;
+    }
+    
+    __free_page(page);
+    return done ? done : ret;
+}
+
+/*
+ * copy_file_range：两边偏移按块对齐时，整块部分直接在磁盘上按块复制，
+ * 不足一块的尾部和其余情况交给splice_copy_file_range在内核中经页缓存复制。
+ */
+ssize_t naive_copy_file_range(struct file *file_in, loff_t pos_in,
+                              struct file *file_out, loff_t pos_out,
+                              size_t len, unsigned int flags)
+{
+    struct inode *src = file_inode(file_in);
+    struct inode *dst = file_inode(file_out);
+    unsigned int bits = src->i_blkbits;
+    loff_t mask = i_blocksize(src) - 1;
+    loff_t isize, copy_len;
+    ssize_t ret = 0, blocks;
+    
+    if (src->i_sb != dst->i_sb || ((pos_in | pos_out) & mask) ||
+        naive_has_inline_data(src) || naive_has_inline_data(dst))
+        return splice_copy_file_range(file_in, pos_in, file_out, pos_out, len);
+    
+    lock_two_nondirectories(src, dst);
+    filemap_invalidate_lock(dst->i_mapping);
+    
+    isize = i_size_read(src);
+    if (pos_in >= isize)
+        goto unlock;
+    copy_len = round_down(min_t(loff_t, len, isize - pos_in), i_blocksize(src));
+    if (!copy_len)
+        goto unlock;
+    
+    ret = file_modified(file_out);
+    if (ret)
+        goto unlock;
+    
+    /* 目标在文件末尾之后：先清零原末尾块的剩余部分 */
+    if (pos_out > i_size_read(dst)) {
+        ret = iomap_zero_range(dst, i_size_read(dst), pos_out - i_size_read(dst),
+                               NULL, &naive_iomap_ops);
+        if (ret)
+            goto unlock;
+    }
+    
+    /* 块复制绕过页缓存：先写回两边，完成后丢弃目标范围的缓存页 */
+    ret = filemap_write_and_wait_range(src->i_mapping, pos_in, pos_in + copy_len - 1);
+    if (!ret)
+        ret = filemap_write_and_wait_range(dst->i_mapping, pos_out,
+                                           pos_out + copy_len - 1);
+    if (ret)
+        goto unlock;
+    
+    blocks = naive_copy_blocks(src, pos_in >> bits, dst, pos_out >> bits,
+                               copy_len >> bits);
+    if (blocks < 0) {
+        ret = blocks;
+        goto unlock;
+    }
+    ret = blocks << bits;
+    
+    invalidate_inode_pages2_range(dst->i_mapping, pos_out >> PAGE_SHIFT,
+                                  (pos_out + ret - 1) >> PAGE_SHIFT);
+    if (pos_out + ret > i_size_read(dst))
+        i_size_write(dst, pos_out + ret);
+    mark_inode_dirty(dst);
+    
+unlock:
+    filemap_invalidate_unlock(dst->i_mapping);
+    unlock_two_nondirectories(src, dst);
+    
+    /* 剩余的尾部 */
+    if (ret >= 0 && ret < len && pos_in + ret < isize) {
+        ssize_t tail = splice_copy_file_range(file_in, pos_in + ret, file_out,
+                                              pos_out + ret, len - ret);
+        if (tail > 0)
+            ret += tail;
+        else if (!ret)
+            ret = tail;
+    }
+    return ret;
+}
+
+/* ========== reflink ========== */
+
+/*
+ * 让目标文件第dst_blk块起的nr_blocks块指向源文件对应的物理块，
+ * 源块引用计数加一，目标原来的块减一。返回完成的块数。
+ */
+static ssize_t naive_remap_blocks(struct inode *src, sector_t src_blk,
+                                  struct inode *dst, sector_t dst_blk,
+                                  sector_t nr_blocks)
+{
+    struct naive_inode_info *src_nii = NAIVE_I(src);
+    struct naive_inode_info *dst_nii = NAIVE_I(dst);
+    struct naive_sb_info *sbi = NAIVE_SB(src->i_sb);
+    sector_t i;
+    int ret = 0;
+    
+    for (i = 0; i < nr_blocks; i++) {
+        sector_t sblk = src_blk + i, dblk = dst_blk + i;
+        u32 bno = 0, old = 0;
+        
+        if (dblk >= NAIVE_MAX_BLOCKS) {
+            ret = -EFBIG;
             break;
         }
         
-        size_t offset_in_block = *pos % NAIVE_BLOCK_SIZE;
-        size_t to_copy = min_t(size_t, remaining, NAIVE_BLOCK_SIZE - offset_in_block);
+        /* 持有源文件的block_lock，块不会在加引用之前被释放 */
+        mutex_lock(&src_nii->block_lock);
+        ret = naive_bmap_read(src, sblk, &bno);
+        if (!ret && bno)
+            ret = naive_ref_block(sbi, NAIVE_BLOCK_NO(bno));
+        mutex_unlock(&src_nii->block_lock);
+        if (ret)
+            break;
         
-        if (copy_from_user(bh->b_data + offset_in_block, buf + ret, to_copy)) {
-            brelse(bh);
-            ret = -EFAULT;
+        /* 目标起点之前的空缺保持为空洞 */
+        mutex_lock(&dst_nii->block_lock);
+        ret = naive_bmap_read(dst, dblk, &old);
+        if (!ret)
+            ret = naive_bmap_write(dst, dblk, bno);
+        if (!ret) {
+            if (bno)
+                inode_add_bytes(dst, i_blocksize(dst));
+            if (old)
+                inode_sub_bytes(dst, i_blocksize(dst));
+        }
+        mutex_unlock(&dst_nii->block_lock);
+        if (ret) {
+            if (bno)
+                naive_free_block(sbi, NAIVE_BLOCK_NO(bno));
             break;
         }
         
-        mark_buffer_dirty(bh);
-        brelse(bh);
+        if (old)
+            naive_free_block(sbi, NAIVE_BLOCK_NO(old));
+    }
+    
+    mark_inode_dirty(dst);
+    return i ? i : ret;
+}
+
+/*
+ * FICLONE/FICLONERANGE/FIDEDUPERANGE：只修改块指针和引用计数，不复制数据。
+ * 之后任何一方写共享块时由写时复制换成新块。
+ */
+loff_t naive_remap_file_range(struct file *file_in, loff_t pos_in,
+                              struct file *file_out, loff_t pos_out,
+                              loff_t len, unsigned int remap_flags)
+{
+    struct inode *src = file_inode(file_in);
+    struct inode *dst = file_inode(file_out);
+    unsigned int bits = src->i_blkbits;
+    ssize_t blocks;
+    loff_t ret;
+    
+    if (remap_flags & ~(REMAP_FILE_DEDUP | REMAP_FILE_ADVISORY))
+        return -EINVAL;
+    if (!NAIVE_SB(src->i_sb)->refcount)
+        return -EOPNOTSUPP;
+    
+    lock_two_nondirectories(src, dst);
+    filemap_invalidate_lock_two(src->i_mapping, dst->i_mapping);
+    
+    /* 检查对齐和范围、写回两边的脏页；去重时比较内容 */
+    ret = generic_remap_file_range_prep(file_in, pos_in, file_out, pos_out,
+                                        &len, remap_flags);
+    if (ret < 0 || len == 0)
+        goto unlock;
+    
+    /* 内联文件没有可共享的块 */
+    ret = naive_inline_convert(src);
+    if (!ret)
+        ret = naive_inline_convert(dst);
+    if (ret)
+        goto unlock;
+    
+    /* 目标在文件末尾之后：原末尾块的剩余部分清零并写回 */
+    if (pos_out > i_size_read(dst)) {
+        loff_t isize = i_size_read(dst);
+        
+        ret = iomap_zero_range(dst, isize, pos_out - isize, NULL, &naive_iomap_ops);
+        if (!ret)
+            ret = filemap_write_and_wait_range(dst->i_mapping, isize, pos_out - 1);
+        if (ret)
+            goto unlock;
+    }
+    
+    blocks = naive_remap_blocks(src, pos_in >> bits, dst, pos_out >> bits,
+                                DIV_ROUND_UP(len, i_blocksize(src)));
+    if (blocks < 0) {
+        ret = blocks;
+        goto unlock;
+    }
+    ret = min_t(loff_t, len, (loff_t)blocks << bits);
+    
+    /* 目标范围的缓存页仍对应旧块 */
+    invalidate_inode_pages2_range(dst->i_mapping, pos_out >> PAGE_SHIFT,
+                                  (pos_out + ret - 1) >> PAGE_SHIFT);
+    if (pos_out + ret > i_size_read(dst)) {
+        i_size_write(dst, pos_out + ret);
+        mark_inode_dirty(dst);
+    }
+    
+unlock:
+    filemap_invalidate_unlock_two(src->i_mapping, dst->i_mapping);
+    unlock_two_nondirectories(src, dst);
+    return ret;
+}
+
+/* SEEK_HOLE/SEEK_DATA按块映射查找，未写入块视为空洞 */
+loff_t naive_file_llseek(struct file *file, loff_t offset, int whence)
+{
+    struct inode *inode = file->f_mapping->host;
+    
+    switch (whence) {
+    case SEEK_HOLE:
+        inode_lock_shared(inode);
+        offset = iomap_seek_hole(inode, offset, &naive_iomap_ops);
+        inode_unlock_shared(inode);
+        break;
+    case SEEK_DATA:
+        inode_lock_shared(inode);
+        offset = iomap_seek_data(inode, offset, &naive_iomap_ops);
+        inode_unlock_shared(inode);
+        break;
+    default:
+        return generic_file_llseek(file, offset, whence);
+    }
+    
+    if (offset < 0)
+        return offset;
+    return vfs_setpos(file, offset, inode->i_sb->s_maxbytes);
+}
+
+/* ========== fallocate ========== */
+
+#define NAIVE_FALLOC_FL_SUPPORTED \
+    (FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE | FALLOC_FL_ZERO_RANGE)
+
+/* 为[first, last)中的空洞分配未写入块 */
+static int naive_prealloc_blocks(struct inode *inode, sector_t first, sector_t last)
+{
+    while (first < last) {
+        bool new;
+        u32 bno;
+        int n;
         
-        *pos += to_copy;
-        remaining -= to_copy;
-        ret += to_copy;
+        n = naive_get_block(inode, first, min_t(sector_t, last - first, UINT_MAX),
+                            NAIVE_GET_BLOCK_CREATE | NAIVE_GET_BLOCK_UNWRITTEN,
+                            &bno, &new);
+        if (n < 0)
+            return n;
+        first += n;
+    }
+    return 0;
+}
+
+/*
+ * 释放[offset, offset + len)：首尾不足一块的部分在页缓存中清零，
+ * 完整的块写回后丢弃缓存页并释放。
+ */
+static int naive_punch_range(struct inode *inode, loff_t offset, loff_t len,
+                             sector_t *first, sector_t *last)
+{
+    unsigned int bits = inode->i_blkbits;
+    loff_t end = offset + len;
+    loff_t start_aligned = round_up(offset, i_blocksize(inode));
+    loff_t end_aligned = round_down(end, i_blocksize(inode));
+    int ret;
+    
+    ret = filemap_write_and_wait_range(inode->i_mapping, offset, end - 1);
+    if (ret)
+        return ret;
+    
+    if (start_aligned >= end_aligned) {
+        /* 范围落在一个块内 */
+        *first = *last = 0;
+        return iomap_zero_range(inode, offset, len, NULL, &naive_iomap_ops);
     }
     
-    /* 更新文件大小 */
-    if (*pos > inode->i_size) {
-        inode->i_size = *pos;
+    if (offset < start_aligned) {
+        ret = iomap_zero_range(inode, offset, start_aligned - offset,
+                               NULL, &naive_iomap_ops);
+        if (ret)
+            return ret;
+    }
+    if (end_aligned < end) {
+        ret = iomap_zero_range(inode, end_aligned, end - end_aligned,
+                               NULL, &naive_iomap_ops);
+        if (ret)
+            return ret;
+    }
+    
+    truncate_pagecache_range(inode, start_aligned, end_aligned - 1);
+    *first = start_aligned >> bits;
+    *last = end_aligned >> bits;
+    naive_free_block_range(inode, *first, *last - *first);
+    return 0;
+}
+
+/*
+ * fallocate：
+ *   默认/KEEP_SIZE  为范围内的空洞预分配连续的未写入块
+ *   PUNCH_HOLE      释放范围内的块，读出为0
+ *   ZERO_RANGE      释放后重新分配为未写入块，不写磁盘
+ * 未写入块读出为0，不会暴露磁盘上的旧数据。
+ */
+long naive_fallocate(struct file *file, int mode, loff_t offset, loff_t len)
+{
+    struct inode *inode = file_inode(file);
+    loff_t end = offset + len;
+    sector_t first, last;
+    long ret;
+    
+    if (mode & ~NAIVE_FALLOC_FL_SUPPORTED)
+        return -EOPNOTSUPP;
+    
+    inode_lock(inode);
+    /* 等待进行中的直接I/O，并阻止缺页与本操作并发 */
+    inode_dio_wait(inode);
+    filemap_invalidate_lock(inode->i_mapping);
+    
+    if (!(mode & FALLOC_FL_KEEP_SIZE) && end > i_size_read(inode)) {
+        ret = inode_newsize_ok(inode, end);
+        if (ret)
+            goto unlock;
+    }
+    
+    ret = file_modified(file);
+    if (ret)
+        goto unlock;
+    
+    /* 打洞和预分配都按块进行 */
+    ret = naive_inline_convert(inode);
+    if (ret)
+        goto unlock;
+    
+    if (mode & (FALLOC_FL_PUNCH_HOLE | FALLOC_FL_ZERO_RANGE)) {
+        ret = naive_punch_range(inode, offset, len, &first, &last);
+        if (!ret && (mode & FALLOC_FL_ZERO_RANGE))
+            ret = naive_prealloc_blocks(inode, first, last);
+    } else {
+        ret = naive_prealloc_blocks(inode, offset >> inode->i_blkbits,
+                                    DIV_ROUND_UP(end, i_blocksize(inode)));
+    }
+    if (ret)
+        goto unlock;
+    
+    if (!(mode & FALLOC_FL_KEEP_SIZE) && end > i_size_read(inode)) {
+        i_size_write(inode, end);
         mark_inode_dirty(inode);
     }
     
-    /* 更新时间 */
-    struct timespec64 ts;
-    ktime_get_real_ts64(&ts);
-    inode_set_mtime_to_ts(inode, ts);
-    inode_set_ctime_to_ts(inode, ts);
+unlock:
+    filemap_invalidate_unlock(inode->i_mapping);
+    inode_unlock(inode);
+    return ret;
+}
+
+/* ========== 截断 ========== */
+
+/*
+ * 修改普通文件的大小。缩小时把新末尾所在块的尾部清零，丢弃其后的页缓存，
+ * 再成段释放之后的块；扩大时清零旧末尾之后的已映射部分，新增部分是空洞。
+ * 调用者持有inode锁。
+ */
+static int naive_setsize(struct inode *inode, loff_t newsize)
+{
+    loff_t oldsize = i_size_read(inode);
+    int ret;
+    
+    /* 等待进行中的直接I/O，并阻止缺页与截断并发 */
+    inode_dio_wait(inode);
+    filemap_invalidate_lock(inode->i_mapping);
+    
+    /* 内联区放不下新大小时先转换 */
+    if (newsize > NAIVE_INLINE_SIZE) {
+        ret = naive_inline_convert(inode);
+        if (ret)
+            goto unlock;
+    }
+    
+    if (newsize < oldsize)
+        ret = iomap_truncate_page(inode, newsize, NULL, &naive_iomap_ops);
+    else
+        ret = iomap_zero_range(inode, oldsize, newsize - oldsize,
+                               NULL, &naive_iomap_ops);
+    if (ret)
+        goto unlock;
+    
+    /* 更新i_size并丢弃newsize之后的页缓存 */
+    truncate_setsize(inode, newsize);
+    if (newsize < oldsize)
+        naive_free_blocks_from(inode, DIV_ROUND_UP(newsize, i_blocksize(inode)));
+    
+    inode_set_mtime_to_ts(inode, inode_set_ctime_current(inode));
+    mark_inode_dirty(inode);
+    
+unlock:
+    filemap_invalidate_unlock(inode->i_mapping);
+    return ret;
+}
+
+/* 修改属性：ftruncate、O_TRUNC、chmod、chown、utimes等 */
+int naive_setattr(struct mnt_idmap *idmap, struct dentry *dentry,
+                  struct iattr *iattr)
+{
+    struct inode *inode = d_inode(dentry);
+    int ret;
+    
+    ret = setattr_prepare(idmap, dentry, iattr);
+    if (ret)
+        return ret;
+    
+    if ((iattr->ia_valid & ATTR_SIZE) && S_ISREG(inode->i_mode) &&
+        iattr->ia_size != i_size_read(inode)) {
+        ret = naive_setsize(inode, iattr->ia_size);
+        if (ret)
+            return ret;
+    }
+    
+    setattr_copy(idmap, inode, iattr);
+    mark_inode_dirty(inode);
+    return 0;
+}
+
+/* ========== 符号链接 ========== */
+
+/*
+ * 长符号链接的目标存放在数据块中。分配好块后直接把目标放进页缓存并标脏，
+ * get_link从页缓存取得，由回写落盘。len包含结尾的'\0'，不超过一页。
+ */
+int naive_symlink_write(struct inode *inode, const char *symname,
+                        unsigned int len)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    struct folio *folio;
+    int ret;
+    
+    mutex_lock(&nii->block_lock);
+    ret = naive_file_fill_blocks(inode, 0, DIV_ROUND_UP(len, NAIVE_BLOCK_SIZE), 0);
+    mutex_unlock(&nii->block_lock);
+    if (ret)
+        return ret;
+    
+    folio = filemap_grab_folio(inode->i_mapping, 0);
+    if (IS_ERR(folio))
+        return PTR_ERR(folio);
+    
+    memcpy(folio_address(folio), symname, len);
+    folio_zero_range(folio, len, folio_size(folio) - len);
+    folio_mark_uptodate(folio);
+    folio_mark_dirty(folio);
+    folio_unlock(folio);
+    folio_put(folio);
+    return 0;
+}
+
+/* ========== 在线整理 ========== */
+
+/* 每次搬移的最大块数（1MB），期间这个文件的读写和缺页等待 */
+#define NAIVE_DEFRAG_CHUNK 2048
+
+/*
+ * 从blk开始找一段可以搬移的块：都已分配且不与其他文件共享，最多max块。
+ * 返回块数，*extents为其中物理上连续的段数；blk处是空洞或共享块时返回0。
+ * 调用者持有block_lock。
+ */
+static sector_t naive_defrag_span(struct inode *inode, sector_t blk,
+                                  sector_t max, unsigned int *extents)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    u32 ptr, prev = 0;
+    bool shared;
+    sector_t n;
+    
+    *extents = 0;
+    for (n = 0; n < max; n++) {
+        if (naive_bmap_read(inode, blk + n, &ptr) || !ptr)
+            break;
+        naive_shared_extent(sbi, NAIVE_BLOCK_NO(ptr), 1, &shared);
+        if (shared)
+            break;
+        if (!n || NAIVE_BLOCK_NO(ptr) != NAIVE_BLOCK_NO(prev) + 1)
+            (*extents)++;
+        prev = ptr;
+    }
+    return n;
+}
+
+/*
+ * 把文件[blk, blk + n)的数据复制到从new开始的连续块，再把块指针指向
+ * 新块，原来的块号记在old中。块映射同步写回后才释放原来的块，崩溃后
+ * 文件要么仍指向原来的块，要么指向已写好数据的新块。调用者持有inode锁
+ * 和invalidate_lock，页缓存已写回。
+ */
+static int naive_defrag_move(struct inode *inode, sector_t blk, sector_t n,
+                             u32 new, u32 *old, struct page *page)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    sector_t done = 0, i;
+    u32 ptr, first;
+    unsigned int m;
+    int ret = 0;
+    
+    while (done < n) {
+        mutex_lock(&nii->block_lock);
+        naive_bmap_read(inode, blk + done, &ptr);
+        old[done] = ptr;
+        first = NAIVE_BLOCK_NO(ptr);
+        for (m = 1; done + m < n && m < NAIVE_COPY_BLOCKS; m++) {
+            if (naive_bmap_read(inode, blk + done + m, &ptr) ||
+                NAIVE_BLOCK_NO(ptr) != first + m)
+                break;
+            old[done + m] = ptr;
+        }
+        mutex_unlock(&nii->block_lock);
+        
+        ret = naive_rw_blocks(inode->i_sb, REQ_OP_READ, first, m, page);
+        if (!ret)
+            ret = naive_rw_blocks(inode->i_sb, REQ_OP_WRITE, new + done, m, page);
+        if (ret) {
+            naive_free_blocks(sbi, new, n);
+            return ret;
+        }
+        done += m;
+    }
+    
+    /* 间接块已存在，设置指针不会失败；未写入标记随块一起搬移 */
+    mutex_lock(&nii->block_lock);
+    for (i = 0; i < n; i++)
+        naive_bmap_write(inode, blk + i,
+                         (new + i) | (old[i] & NAIVE_BLOCK_UNWRITTEN));
+    mutex_unlock(&nii->block_lock);
+    mark_inode_dirty(inode);
+    
+    /*
+     * 写回失败时磁盘上的块映射可能仍指向原来的块，不能释放它们；
+     * 宁可让原来的块泄漏。
+     */
+    ret = sync_mapping_buffers(inode->i_mapping);
+    if (!ret)
+        ret = write_inode_now(inode, 1);
+    if (ret)
+        return ret;
+    
+    /* 连续的原块一次释放 */
+    for (i = 0; i < n; i += m) {
+        first = NAIVE_BLOCK_NO(old[i]);
+        for (m = 1; i + m < n && NAIVE_BLOCK_NO(old[i + m]) == first + m; m++)
+            ;
+        naive_free_blocks(sbi, first, m);
+    }
+    return 0;
+}
+
+/*
+ * NAIVE_IOC_DEFRAG：把文件中物理上分散的块逐段搬到连续的空闲区，后一段
+ * 紧接着前一段分配。每段持有inode锁和invalidate_lock，读写在这一段期间
+ * 等待，段与段之间照常进行。空洞、共享块和已经连续的段不动；找不到
+ * 足够长的空闲区时跳过这一段。间接块不搬移。
+ */
+int naive_defrag_file(struct file *file, struct naive_defrag_range *range)
+{
+    struct inode *inode = file_inode(file);
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    sector_t blk = range->start, end, n;
+    unsigned long goal = 0;
+    unsigned int extents;
+    struct page *page;
+    u32 new, last;
+    u32 *old;
+    int ret = 0;
+    
+    if (!S_ISREG(inode->i_mode))
+        return -EINVAL;
+    
+    range->moved = 0;
+    page = alloc_page(GFP_NOFS);
+    old = kmalloc_array(NAIVE_DEFRAG_CHUNK, sizeof(u32), GFP_NOFS);
+    if (!page || !old) {
+        ret = -ENOMEM;
+        goto out;
+    }
+    
+    for (;;) {
+        inode_lock(inode);
+        inode_dio_wait(inode);
+        filemap_invalidate_lock(inode->i_mapping);
+        
+        end = DIV_ROUND_UP(i_size_read(inode), i_blocksize(inode));
+        if (range->start < end && range->len < end - range->start)
+            end = range->start + range->len;
+        if (naive_has_inline_data(inode) || blk >= end) {
+            filemap_invalidate_unlock(inode->i_mapping);
+            inode_unlock(inode);
+            break;
+        }
+        
+        n = min_t(sector_t, end - blk, NAIVE_DEFRAG_CHUNK);
+        ret = filemap_write_and_wait_range(inode->i_mapping,
+                                           (loff_t)blk << inode->i_blkbits,
+                                           ((loff_t)(blk + n) << inode->i_blkbits) - 1);
+        if (!ret) {
+            mutex_lock(&nii->block_lock);
+            n = naive_defrag_span(inode, blk, n, &extents);
+            if (n && !naive_bmap_read(inode, blk + n - 1, &last))
+                goal = NAIVE_BLOCK_NO(last) + 1;
+            mutex_unlock(&nii->block_lock);
+            
+            if (extents > 1 && !naive_alloc_run(sbi, goal, n, &new)) {
+                ret = naive_defrag_move(inode, blk, n, new, old, page);
+                if (!ret)
+                    range->moved += n;
+                goal = new + n;
+            }
+            /* 空洞或共享块：跳过一块 */
+            blk += max_t(sector_t, n, 1);
+        }
+        
+        filemap_invalidate_unlock(inode->i_mapping);
+        inode_unlock(inode);
+        if (ret)
+            break;
+        if (fatal_signal_pending(current)) {
+            ret = -EINTR;
+            break;
+        }
+        cond_resched();
+    }
     
 out:
+    kfree(old);
+    if (page)
+        __free_page(page);
+    return range->moved ? 0 : ret;
+}
+
+/* ========== 内存映射 ========== */
+
+/*
+ * 共享映射第一次写某页时调用：为该页分配块并把页标记为脏，
+ * 之后的写直接落在页缓存上，由回写负责落盘。
+ * invalidate锁防止与截断并发。
+ */
+static vm_fault_t naive_page_mkwrite(struct vm_fault *vmf)
+{
+    struct file *file = vmf->vma->vm_file;
+    struct inode *inode = file_inode(file);
+    vm_fault_t ret;
+    
+    sb_start_pagefault(inode->i_sb);
+    file_update_time(file);
+    
+    filemap_invalidate_lock_shared(inode->i_mapping);
+    ret = iomap_page_mkwrite(vmf, &naive_iomap_ops);
+    filemap_invalidate_unlock_shared(inode->i_mapping);
+    
+    sb_end_pagefault(inode->i_sb);
+    return ret;
+}
+
+static const struct vm_operations_struct naive_file_vm_ops = {
+    .fault          = filemap_fault,
+    .map_pages      = filemap_map_pages,
+    .page_mkwrite   = naive_page_mkwrite,
+};
+
+int naive_file_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    file_accessed(file);
+    vma->vm_ops = &naive_file_vm_ops;
+    return 0;
+}
+
+/* ========== 地址空间操作 ========== */
+
+static int naive_read_folio(struct file *file, struct folio *folio)
+{
+    return iomap_read_folio(folio, &naive_iomap_ops);
+}
+
+static void naive_readahead(struct readahead_control *rac)
+{
+    iomap_readahead(rac, &naive_iomap_ops);
+}
+
+/*
+ * 回写遇到共享块：为映射的这段分配新块，把数据写到新块，块指针不变。
+ * 脏块在页缓存中是完整的，不需要复制旧内容。写入成功后由
+ * naive_remap_cow_blocks()换上新块；失败则释放新块，文件仍指向原来的块。
+ */
+static int naive_map_cow_blocks(struct inode *inode, struct iomap *iomap)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    unsigned int blkbits = inode->i_blkbits;
+    sector_t iblock = iomap->offset >> blkbits;
+    unsigned long goal = 0;
+    u32 prev, bno;
+    int ret;
+    
+    mutex_lock(&nii->block_lock);
+    if (iblock > 0 && !naive_bmap_read(inode, iblock - 1, &prev) && prev)
+        goal = NAIVE_BLOCK_NO(prev) + 1;
+    mutex_unlock(&nii->block_lock);
+    
+    ret = naive_alloc_blocks(NAIVE_SB(inode->i_sb), goal,
+                             iomap->length >> blkbits, &bno);
+    if (ret < 0)
+        return ret;
+    
+    /* 新块会被整块写入，不再是未写入状态 */
+    iomap->type = IOMAP_MAPPED;
+    iomap->addr = (u64)bno << blkbits;
+    iomap->length = (u64)ret << blkbits;
+    return 0;
+}
+
+/* 写时复制的数据已写入[bno, bno + count)：换上新块，旧块的引用计数减一 */
+static void naive_remap_cow_blocks(struct inode *inode, sector_t iblock,
+                                   sector_t count, u32 bno)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    sector_t i;
+    
+    mutex_lock(&nii->block_lock);
+    for (i = 0; i < count; i++) {
+        u32 old;
+        
+        /* 块在回写期间已被释放（截断）：新块不再需要 */
+        if (iblock + i >= nii->block_count ||
+            naive_bmap_read(inode, iblock + i, &old) || !old ||
+            naive_bmap_write(inode, iblock + i, bno + i)) {
+            naive_free_block(sbi, bno + i);
+            continue;
+        }
+        naive_free_block(sbi, NAIVE_BLOCK_NO(old));
+    }
+    mutex_unlock(&nii->block_lock);
+    mark_inode_dirty(inode);
+}
+
+/* 回写：复用iomap_begin的映射，连续的脏块由iomap合并成一个bio */
+static int naive_map_blocks(struct iomap_writepage_ctx *wpc,
+                            struct inode *inode, loff_t offset, unsigned int len)
+{
+    int ret;
+    
+    if (offset >= wpc->iomap.offset &&
+        offset < wpc->iomap.offset + wpc->iomap.length)
+        return 0;
+    
+    /*
+     * 映射只覆盖这段脏块，写时复制分配的新块都会被写入。未写入块保持
+     * 未写入，写入成功后才由naive_end_ioend()转换，写失败时仍读出为0。
+     */
+    ret = naive_iomap_begin(inode, offset, len, 0, &wpc->iomap, NULL);
+    if (ret)
+        return ret;
+    if (wpc->iomap.flags & IOMAP_F_SHARED)
+        ret = naive_map_cow_blocks(inode, &wpc->iomap);
+    return ret;
+}
+
+/* 回写完成的后续处理，在进程上下文中调用 */
+static void naive_end_ioend(struct iomap_ioend *ioend)
+{
+    struct inode *inode = ioend->io_inode;
+    unsigned int blkbits = inode->i_blkbits;
+    sector_t iblock = ioend->io_offset >> blkbits;
+    sector_t count = DIV_ROUND_UP(ioend->io_offset + ioend->io_size,
+                                  i_blocksize(inode)) - iblock;
+    u32 bno = ioend->io_sector >> (blkbits - SECTOR_SHIFT);
+    int error = blk_status_to_errno(ioend->io_bio.bi_status);
+    
+    if (ioend->io_flags & IOMAP_F_SHARED) {
+        if (error)
+            naive_free_blocks(NAIVE_SB(inode->i_sb), bno, count);
+        else
+            naive_remap_cow_blocks(inode, iblock, count, bno);
+    } else if (!error && ioend->io_type == IOMAP_UNWRITTEN) {
+        naive_convert_unwritten(inode, iblock, count);
+    }
+    iomap_finish_ioends(ioend, error);
+}
+
+/* 修改块指针要持有block_lock，不能在bio完成回调中进行，交给work处理 */
+void naive_end_io_work(struct work_struct *work)
+{
+    struct naive_inode_info *nii = container_of(work, struct naive_inode_info,
+                                                ioend_work);
+    struct iomap_ioend *ioend;
+    unsigned long flags;
+    LIST_HEAD(list);
+    
+    spin_lock_irqsave(&nii->ioend_lock, flags);
+    list_splice_init(&nii->ioend_list, &list);
+    spin_unlock_irqrestore(&nii->ioend_lock, flags);
+    
+    while ((ioend = list_first_entry_or_null(&list, struct iomap_ioend, io_list))) {
+        list_del_init(&ioend->io_list);
+        naive_end_ioend(ioend);
+    }
+}
+
+static void naive_end_bio(struct bio *bio)
+{
+    struct iomap_ioend *ioend = iomap_ioend_from_bio(bio);
+    struct naive_inode_info *nii = NAIVE_I(ioend->io_inode);
+    unsigned long flags;
+    
+    spin_lock_irqsave(&nii->ioend_lock, flags);
+    if (list_empty(&nii->ioend_list))
+        queue_work(system_unbound_wq, &nii->ioend_work);
+    list_add_tail(&ioend->io_list, &nii->ioend_list);
+    spin_unlock_irqrestore(&nii->ioend_lock, flags);
+}
+
+/*
+ * 写入未写入块或写时复制的ioend换用naive_end_bio，完成后再修改块指针；
+ * 其余ioend仍由iomap在bio完成时直接结束回写。status非0时iomap以错误
+ * 结束这个bio，写时复制分配的新块随之释放。
+ */
+static int naive_submit_ioend(struct iomap_writepage_ctx *wpc, int status)
+{
+    struct iomap_ioend *ioend = wpc->ioend;
+    
+    if (ioend->io_type == IOMAP_UNWRITTEN || (ioend->io_flags & IOMAP_F_SHARED))
+        ioend->io_bio.bi_end_io = naive_end_bio;
+    if (status)
+        return status;
+    submit_bio(&ioend->io_bio);
+    return 0;
+}
+
+static const struct iomap_writeback_ops naive_writeback_ops = {
+    .map_blocks     = naive_map_blocks,
+    .submit_ioend   = naive_submit_ioend,
+};
+
+/*
+ * fsync等路径调用writepages时外层没有plug，这里自己加上，
+ * 使同一文件相邻的ioend在下发时能合并成更大的请求。
+ */
+static int naive_writepages(struct address_space *mapping,
+                            struct writeback_control *wbc)
+{
+    struct iomap_writepage_ctx wpc = { };
+    struct blk_plug plug;
+    int ret;
+    
+    blk_start_plug(&plug);
+    ret = iomap_writepages(mapping, wbc, &wpc, &naive_writeback_ops);
+    blk_finish_plug(&plug);
+    return ret;
+}
+
+static sector_t naive_bmap(struct address_space *mapping, sector_t block)
+{
+    return iomap_bmap(mapping, block, &naive_iomap_ops);
+}
+
+const struct address_space_operations naive_aops = {
+    .read_folio             = naive_read_folio,
+    .readahead              = naive_readahead,
+    .writepages             = naive_writepages,
+    .dirty_folio            = iomap_dirty_folio,
+    .release_folio          = iomap_release_folio,
+    .invalidate_folio       = iomap_invalidate_folio,
+    .migrate_folio          = filemap_migrate_folio,
+    .is_partially_uptodate  = iomap_is_partially_uptodate,
+    .error_remove_folio     = generic_error_remove_folio,
+    .bmap                   = naive_bmap,
+    .direct_IO              = noop_direct_IO,
+};
+
+int naive_fiemap(struct inode *inode, struct fiemap_extent_info *fieinfo,
+                 u64 start, u64 len)
+{
+    int ret;
+    
+    inode_lock_shared(inode);
+    ret = iomap_fiemap(inode, fieinfo, start, len, &naive_iomap_ops);
+    inode_unlock_shared(inode);
     return ret;
 }
@@ -3,6 +3,8 @@
 #include <linux/namei.h>
 #include <linux/pagemap.h>
 
+#include "trace/events/naivefs.h"
+
 /* 创建文件 */
 int naive_create(struct mnt_idmap *idmap, struct inode *dir,
                 struct dentry *dentry, umode_t mode, bool excl)
@@ -13,23 +15,25 @@ int naive_create(struct mnt_idmap *idmap, struct inode *dir,
     int ino;
     int ret;
     
-    printk(KERN_INFO "naivefs: create called for %s\n", dentry->d_name.name);
-    
     /* 分配inode编号 */
-    ino = naive_find_free_inode(sbi);
+    ino = naive_alloc_ino(sbi);
     if (ino == 0)
         return -ENOSPC;
     
     /* 分配inode */
     inode = new_inode(sb);
-    if (!inode)
+    if (!inode) {
+        naive_mark_inode_bitmap(sbi, ino, false);
         return -ENOMEM;
+    }
     
     inode->i_ino = ino;
     inode_init_owner(idmap, inode, dir, mode);
     inode->i_sb = sb;
     inode->i_op = &naive_file_iops;
     inode->i_fop = &naive_file_ops;
+    inode->i_mapping->a_ops = &naive_aops;
+    mapping_set_large_folios(inode->i_mapping);
     
     /* 设置时间 */
     struct timespec64 ts;
@@ -41,20 +45,123 @@ int naive_create(struct mnt_idmap *idmap, struct inode *dir,
     set_nlink(inode, 1);
     inode->i_size = 0;
     
-    /* 标记位图 */
-    sbi->inode_bitmap[(ino - 1) / 8] |= (1 << ((ino - 1) % 8));
+    /* 新文件先以内联方式存放，写满内联区后再分配数据块 */
+    if (naive_has_feature(sbi, NAIVE_FEATURE_INLINE_DATA)) {
+        NAIVE_I(inode)->inline_data = kzalloc(NAIVE_INLINE_SIZE, GFP_KERNEL);
+        if (NAIVE_I(inode)->inline_data)
+            NAIVE_I(inode)->i_flags |= NAIVE_INODE_INLINE_DATA;
+    }
+    
+    ret = naive_init_security(inode, dir, &dentry->d_name);
+    if (ret)
+        goto fail;
     
     /* 添加到目录 */
     ret = naive_add_entry(dir, dentry, ino);
-    if (ret < 0) {
-        iput(inode);
-        return ret;
+    if (ret < 0)
+        goto fail;
+    
+    /* 加入inode哈希，经其他硬链接查找时得到同一个inode */
+    insert_inode_hash(inode);
+    d_instantiate(dentry, inode);
+    return 0;
+    
+fail:
+    /* 链接数为0，iput经evict_inode释放已分配的块和inode编号 */
+    clear_nlink(inode);
+    iput(inode);
+    return ret;
+}
+
+/*
+ * 符号链接的操作集取决于目标存放的位置：内联区中的快速符号链接直接返回
+ * i_link，不需要页缓存；否则经页缓存读取数据块。
+ */
+static void naive_set_symlink_ops(struct inode *inode)
+{
+    if (naive_has_inline_data(inode)) {
+        inode->i_op = &naive_fast_symlink_iops;
+        inode->i_link = NAIVE_I(inode)->inline_data;
+    } else {
+        inode->i_op = &naive_symlink_iops;
+        inode->i_mapping->a_ops = &naive_aops;
+        inode_nohighmem(inode);
     }
+}
+
+/* 创建符号链接：目标放得进内联区时不分配数据块 */
+int naive_symlink(struct mnt_idmap *idmap, struct inode *dir,
+                 struct dentry *dentry, const char *symname)
+{
+    struct inode *inode;
+    struct super_block *sb = dir->i_sb;
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    struct naive_inode_info *nii;
+    unsigned int len = strlen(symname) + 1;
+    int ino;
+    int ret;
+    
+    if (len > PAGE_SIZE)
+        return -ENAMETOOLONG;
+    
+    ino = naive_alloc_ino(sbi);
+    if (ino == 0)
+        return -ENOSPC;
+    
+    inode = new_inode(sb);
+    if (!inode) {
+        naive_mark_inode_bitmap(sbi, ino, false);
+        return -ENOMEM;
+    }
+    
+    nii = NAIVE_I(inode);
+    inode->i_ino = ino;
+    inode_init_owner(idmap, inode, dir, S_IFLNK | S_IRWXUGO);
     
+    struct timespec64 ts;
+    ktime_get_real_ts64(&ts);
+    inode_set_atime_to_ts(inode, ts);
+    inode_set_mtime_to_ts(inode, ts);
+    inode_set_ctime_to_ts(inode, ts);
+    set_nlink(inode, 1);
+    inode->i_size = len - 1;
+    
+    if (len <= NAIVE_INLINE_SIZE &&
+        naive_has_feature(sbi, NAIVE_FEATURE_INLINE_DATA)) {
+        nii->inline_data = kzalloc(NAIVE_INLINE_SIZE, GFP_KERNEL);
+        if (!nii->inline_data) {
+            ret = -ENOMEM;
+            goto fail;
+        }
+        memcpy(nii->inline_data, symname, len);
+        nii->i_flags |= NAIVE_INODE_INLINE_DATA;
+    }
+    naive_set_symlink_ops(inode);
+    
+    if (!naive_has_inline_data(inode)) {
+        ret = naive_symlink_write(inode, symname, len);
+        if (ret)
+            goto fail;
+    }
+    
+    ret = naive_init_security(inode, dir, &dentry->d_name);
+    if (ret)
+        goto fail;
+    
+    ret = naive_add_entry(dir, dentry, ino);
+    if (ret < 0)
+        goto fail;
+    
+    mark_inode_dirty(inode);
+    insert_inode_hash(inode);
     d_instantiate(dentry, inode);
-    printk(KERN_INFO "naivefs: file %s created, inode=%d\n",
-           dentry->d_name.name, ino);
     return 0;
+    
+fail:
+    /* 链接数为0，iput经evict_inode释放已分配的块和inode编号 */
+    clear_nlink(inode);
+    iput(inode);
+    return ret;
 }
 
 /* 查找文件/目录 - 修正返回类型为 struct dentry* */
@@ -64,19 +171,33 @@ struct dentry *naive_lookup(struct inode *dir, struct dentry *dentry, unsigned i
     struct super_block *sb = dir->i_sb;
     struct buffer_head *bh;
     struct naive_dir_record *record;
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
     struct inode *inode = NULL;
+    u64 start_ns = ktime_get_ns();
     int i, j;
     
-    printk(KERN_INFO "naivefs: lookup called for %s\n", dentry->d_name.name);
+    /* 内联目录项 */
+    if (naive_has_inline_data(dir)) {
+        for (j = 0; j < NAIVE_INLINE_DIR_RECORDS; j++) {
+            record = naive_inline_record(dir, j);
+            if (le32_to_cpu(record->i_ino) != 0 &&
+                strncmp(record->filename, dentry->d_name.name,
+                       NAIVE_MAX_FILENAME_LEN) == 0) {
+                inode = naive_iget(sb, le32_to_cpu(record->i_ino));
+                break;
+            }
+        }
+    }
     
     /* 遍历目录项 */
-    for (i = 0; i < nii->block_count; i++) {
+    for (i = 0; !inode && i < nii->block_count; i++) {
         if (nii->block_pointers[i] == 0)
             continue;
             
         bh = sb_bread(sb, nii->block_pointers[i]);
         if (!bh)
             continue;
+        naive_stat_inc(sbi, NAIVE_STAT_LOOKUP_DIR_BLOCKS);
         
         for (j = 0; j < NAIVE_DIR_RECORDS_PER_BLOCK; j++) {
             record = (struct naive_dir_record *)
@@ -95,6 +216,10 @@ struct dentry *naive_lookup(struct inode *dir, struct dentry *dentry, unsigned i
             break;
     }
     
+    naive_stat_inc(sbi, inode ? NAIVE_STAT_LOOKUP_HITS : NAIVE_STAT_LOOKUP_MISSES);
+    naive_stat_latency(sbi, NAIVE_LAT_LOOKUP, start_ns);
+    trace_naivefs_lookup(dir, dentry, inode ? inode->i_ino : 0);
+    
     if (!inode) {
         /* 未找到，返回NULL让VFS处理 */
         return NULL;
@@ -103,41 +228,48 @@ struct dentry *naive_lookup(struct inode *dir, struct dentry *dentry, unsigned i
     return d_splice_alias(inode, dentry);
 }
 
-/* 删除文件 */
+/*
+ * 释放数据块、间接块、扩展属性块和inode编号。链接数为0的inode在
+ * evict_inode中调用，此时已没有人打开它。
+ */
+void naive_delete_inode(struct inode *inode)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    
+    /* 释放数据块前丢弃页缓存，避免之后回写到已被复用的块 */
+    truncate_inode_pages(&inode->i_data, 0);
+    
+    /* 释放数据块和间接块 */
+    naive_free_blocks_from(inode, 0);
+    naive_xattr_delete_inode(inode);
+    
+    /* 释放inode位图 */
+    naive_mark_inode_bitmap(sbi, inode->i_ino, false);
+    
+    inode->i_size = 0;
+}
+
+/* 删除文件：最后一个链接删除后，块在文件不再被打开时才释放 */
 int naive_unlink(struct inode *dir, struct dentry *dentry)
 {
     struct inode *inode = d_inode(dentry);
-    struct super_block *sb = dir->i_sb;
-    struct naive_sb_info *sbi = NAIVE_SB(sb);
-    struct naive_inode_info *nii = NAIVE_I(inode);
     int ret;
-    int i;
-    
-    printk(KERN_INFO "naivefs: unlink called for %s\n", dentry->d_name.name);
     
     /* 从目录中移除 */
     ret = naive_remove_entry(dir, dentry);
     if (ret < 0)
         return ret;
     
-    /* 释放数据块 */
-    for (i = 0; i < nii->block_count; i++) {
-        if (nii->block_pointers[i] != 0) {
-            naive_free_block(sbi, nii->block_pointers[i]);
-            nii->block_pointers[i] = 0;
-        }
-    }
-    nii->block_count = 0;
-    
-    /* 释放inode位图 */
-    int ino = inode->i_ino;
-    sbi->inode_bitmap[(ino - 1) / 8] &= ~(1 << ((ino - 1) % 8));
+    inode_set_mtime_to_ts(dir, inode_set_ctime_current(dir));
+    mark_inode_dirty(dir);
     
     /* 更新inode */
-    clear_nlink(inode);
-    inode->i_size = 0;
+    inode_set_ctime_current(inode);
+    drop_nlink(inode);
+    if (!inode->i_nlink)
+        naive_orphan_add(inode);
+    mark_inode_dirty(inode);
     
-    printk(KERN_INFO "naivefs: file %s removed\n", dentry->d_name.name);
     return 0;
 }
 
@@ -151,8 +283,6 @@ struct inode *naive_iget(struct super_block *sb, unsigned long ino)
     struct naive_inode *disk_inode;
     int inode_table_start;
     
-    printk(KERN_INFO "naivefs: iget called for inode %lu\n", ino);
-    
     /* 首先检查inode是否已经在缓存中 */
     inode = iget_locked(sb, ino);
     if (!inode)
@@ -172,32 +302,62 @@ struct inode *naive_iget(struct super_block *sb, unsigned long ino)
     }
     
     disk_inode = (struct naive_inode *)bh->b_data;
+    naive_stat_inc(sbi, NAIVE_STAT_INODE_READS);
     
     /* 填充inode信息 */
     inode->i_mode = le32_to_cpu(disk_inode->mode);
-    inode->i_uid = le32_to_cpu(disk_inode->i_uid);
-    inode->i_gid = le32_to_cpu(disk_inode->i_gid);
+    i_uid_write(inode, le32_to_cpu(disk_inode->i_uid));
+    i_gid_write(inode, le32_to_cpu(disk_inode->i_gid));
     inode->i_size = le32_to_cpu(disk_inode->file_size);
     set_nlink(inode, le32_to_cpu(disk_inode->i_nlink));
     
-    inode->i_atime.tv_sec = le32_to_cpu(disk_inode->i_atime);
-    inode->i_mtime.tv_sec = le32_to_cpu(disk_inode->i_mtime);
-    inode->i_ctime.tv_sec = le32_to_cpu(disk_inode->i_ctime);
-    inode->i_atime.tv_nsec = inode->i_mtime.tv_nsec = inode->i_ctime.tv_nsec = 0;
+    inode_set_atime(inode, le32_to_cpu(disk_inode->i_atime), 0);
+    inode_set_mtime(inode, le32_to_cpu(disk_inode->i_mtime), 0);
+    inode_set_ctime(inode, le32_to_cpu(disk_inode->i_ctime), 0);
     
     /* 设置操作集 */
     if (S_ISDIR(inode->i_mode)) {
         inode->i_op = &naive_dir_iops;
-        inode->i_fop = &simple_dir_operations;
+        inode->i_fop = &naive_dir_ops;
+    } else if (S_ISLNK(inode->i_mode)) {
+        /* 读出i_flags之后才知道是否为快速符号链接 */
     } else {
         inode->i_op = &naive_file_iops;
         inode->i_fop = &naive_file_ops;
+        inode->i_mapping->a_ops = &naive_aops;
+        mapping_set_large_folios(inode->i_mapping);
     }
     
-    /* 设置块指针 */
+    nii->i_flags = le32_to_cpu(disk_inode->i_flags);
+    if (nii->i_flags & NAIVE_INODE_INLINE_DATA) {
+        nii->inline_data = kmemdup(disk_inode->i_inline, NAIVE_INLINE_SIZE,
+                                   GFP_KERNEL);
+        if (!nii->inline_data) {
+            brelse(bh);
+            iget_failed(inode);
+            return ERR_PTR(-ENOMEM);
+        }
+    }
+    if (S_ISLNK(inode->i_mode))
+        naive_set_symlink_ops(inode);
+    
+    /* 设置块指针，值为0的是空洞 */
     nii->block_count = le32_to_cpu(disk_inode->block_count);
-    for (int i = 0; i < nii->block_count; i++) {
+    for (int i = 0; i < min(nii->block_count, NAIVE_BLOCK_PER_FILE); i++)
         nii->block_pointers[i] = le32_to_cpu(disk_inode->block[i]);
+    nii->i_ind_block = le32_to_cpu(disk_inode->i_ind_block);
+    nii->i_dind_block = le32_to_cpu(disk_inode->i_dind_block);
+    nii->i_xattr_block = le32_to_cpu(disk_inode->i_xattr_block);
+    memcpy(nii->i_xattr, disk_inode->i_xattr, NAIVE_INODE_XATTR_SIZE);
+    nii->i_next_orphan = le32_to_cpu(disk_inode->i_next_orphan);
+    
+    /* 旧镜像没有记录i_blocks，只有直接指针，逐个计数 */
+    if (disk_inode->i_blocks) {
+        inode->i_blocks = le32_to_cpu(disk_inode->i_blocks);
+    } else {
+        for (int i = 0; i < min(nii->block_count, NAIVE_BLOCK_PER_FILE); i++)
+            if (nii->block_pointers[i])
+                inode_add_bytes(inode, NAIVE_BLOCK_SIZE);
     }
     
     brelse(bh);
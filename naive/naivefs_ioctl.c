@@ -0,0 +1,92 @@
+#include "naivefs.h"
+
+#include <linux/uaccess.h>
+#include <linux/capability.h>
+
+/*
+ * naivefs的ioctl。FITRIM和NAIVE_IOC_RESIZE作用于整个文件系统，普通文件和
+ * 目录都可以发起（fstrim打开的是挂载点）；NAIVE_IOC_DEFRAG作用于打开的文件。
+ */
+
+/* FITRIM：丢弃空闲块，供fstrim使用 */
+static int naive_ioctl_fitrim(struct super_block *sb, struct fstrim_range __user *arg)
+{
+    struct fstrim_range range;
+    int ret;
+    
+    if (!capable(CAP_SYS_ADMIN))
+        return -EPERM;
+    if (sb_rdonly(sb))
+        return -EROFS;
+    if (copy_from_user(&range, arg, sizeof(range)))
+        return -EFAULT;
+    
+    ret = naive_trim_fs(sb, &range);
+    if (ret)
+        return ret;
+    
+    if (copy_to_user(arg, &range, sizeof(range)))
+        return -EFAULT;
+    return 0;
+}
+
+/* 在线整理，文件须以写方式打开，见naive_defrag_file */
+static int naive_ioctl_defrag(struct file *filp, struct naive_defrag_range __user *arg)
+{
+    struct naive_defrag_range range;
+    int ret;
+    
+    if (!(filp->f_mode & FMODE_WRITE))
+        return -EBADF;
+    if (!inode_owner_or_capable(file_mnt_idmap(filp), file_inode(filp)))
+        return -EACCES;
+    if (copy_from_user(&range, arg, sizeof(range)))
+        return -EFAULT;
+    
+    ret = mnt_want_write_file(filp);
+    if (ret)
+        return ret;
+    ret = naive_defrag_file(filp, &range);
+    mnt_drop_write_file(filp);
+    if (ret)
+        return ret;
+    
+    if (copy_to_user(arg, &range, sizeof(range)))
+        return -EFAULT;
+    return 0;
+}
+
+/* 在线扩容，见naive_resize_fs */
+static int naive_ioctl_resize(struct file *filp, __u64 __user *arg)
+{
+    u64 new_total;
+    int ret;
+    
+    if (!capable(CAP_SYS_ADMIN))
+        return -EPERM;
+    if (get_user(new_total, arg))
+        return -EFAULT;
+    
+    ret = mnt_want_write_file(filp);
+    if (ret)
+        return ret;
+    ret = naive_resize_fs(file_inode(filp)->i_sb, new_total);
+    mnt_drop_write_file(filp);
+    return ret;
+}
+
+long naive_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+    struct super_block *sb = file_inode(filp)->i_sb;
+    
+    switch (cmd) {
+    case FITRIM:
+        return naive_ioctl_fitrim(sb, (struct fstrim_range __user *)arg);
+    case NAIVE_IOC_DEFRAG:
+        return naive_ioctl_defrag(filp, (struct naive_defrag_range __user *)arg);
+    case NAIVE_IOC_RESIZE:
+        return naive_ioctl_resize(filp, (__u64 __user *)arg);
+    default:
+        return -ENOTTY;
+    }
+}
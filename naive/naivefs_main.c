@@ -6,66 +6,116 @@
 #include <linux/slab.h>
 #include <linux/buffer_head.h>
 
+#define CREATE_TRACE_POINTS
+#include "trace/events/naivefs.h"
+
 /* 超级块操作集 */
-static const struct super_operations naive_sops = {
+const struct super_operations naive_sops = {
     .alloc_inode    = naive_alloc_inode,
-    .destroy_inode  = naive_destroy_inode,
+    .free_inode     = naive_free_inode,
     .put_super      = naive_put_super,
     .write_inode    = naive_write_inode,
+    .drop_inode     = naive_drop_inode,
     .evict_inode    = naive_evict_inode,
+    .sync_fs        = naive_sync_fs,
+    .show_options   = naive_show_options,
 };
 
 /* inode操作集 - 目录 */
-static const struct inode_operations naive_dir_iops = {
+const struct inode_operations naive_dir_iops = {
     .create     = naive_create,
     .lookup     = naive_lookup,
+    .link       = naive_link,
     .unlink     = naive_unlink,
     .mkdir      = naive_mkdir,
     .rmdir      = naive_rmdir,
+    .symlink    = naive_symlink,
+    .rename     = naive_rename,
     .getattr    = simple_getattr,
+    .listxattr  = naive_listxattr,
 };
 
 /* inode操作集 - 文件 */
-static const struct inode_operations naive_file_iops = {
+const struct inode_operations naive_file_iops = {
+    .getattr    = simple_getattr,
+    .listxattr  = naive_listxattr,
+    .setattr    = naive_setattr,
+    .fiemap     = naive_fiemap,
+    .update_time = naive_update_time,
+};
+
+/* inode操作集 - 符号链接，目标在数据块中，经页缓存读取 */
+const struct inode_operations naive_symlink_iops = {
+    .get_link   = page_get_link,
+    .getattr    = simple_getattr,
+    .listxattr  = naive_listxattr,
+    .setattr    = naive_setattr,
+};
+
+/* inode操作集 - 快速符号链接，目标在inode的内联区中 */
+const struct inode_operations naive_fast_symlink_iops = {
+    .get_link   = simple_get_link,
     .getattr    = simple_getattr,
+    .listxattr  = naive_listxattr,
+    .setattr    = naive_setattr,
 };
 
 /* 文件操作集 */
-static const struct file_operations naive_file_ops = {
+const struct file_operations naive_file_ops = {
     .owner      = THIS_MODULE,
-    .read       = naive_file_read,
-    .write      = naive_file_write,
-    .llseek     = generic_file_llseek,
+    .read_iter  = naive_file_read_iter,
+    .write_iter = naive_file_write_iter,
+    .llseek     = naive_file_llseek,
+    .mmap       = naive_file_mmap,
+    .splice_read = filemap_splice_read,
+    .splice_write = iter_file_splice_write,
+    .copy_file_range = naive_copy_file_range,
+    .remap_file_range = naive_remap_file_range,
+    .fallocate  = naive_fallocate,
     .open       = naive_file_open,
     .release    = naive_file_release,
+    .fsync      = generic_file_fsync,
+    .unlocked_ioctl = naive_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
+    .fop_flags  = FOP_BUFFER_RASYNC | FOP_BUFFER_WASYNC,
 };
 
-/* 挂载函数 */
-static struct dentry *naive_mount(struct file_system_type *fs_type,
-                                 int flags, const char *dev_name,
-                                 void *data)
-{
-    printk(KERN_INFO "naivefs: mount called for %s\n", dev_name);
-    return mount_bdev(fs_type, flags, dev_name, data, naive_fill_super);
-}
+/* 目录操作集：目录项经dcache遍历，另加文件系统级ioctl（fstrim作用于挂载点） */
+const struct file_operations naive_dir_ops = {
+    .open       = dcache_dir_open,
+    .release    = dcache_dir_close,
+    .llseek     = dcache_dir_lseek,
+    .read       = generic_read_dir,
+    .iterate_shared = dcache_readdir,
+    .fsync      = noop_fsync,
+    .unlocked_ioctl = naive_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
+};
 
 /* 文件系统类型定义 */
 static struct file_system_type naive_fs_type = {
     .owner      = THIS_MODULE,
     .name       = "naive",
-    .mount      = naive_mount,
-    .kill_sb    = kill_block_super,
+    .init_fs_context = naive_init_fs_context,
+    .parameters = naive_fs_parameters,
+    .kill_sb    = naive_kill_sb,
     .fs_flags   = FS_REQUIRES_DEV,
 };
 
 /* 模块初始化 */
 static int __init init_naivefs(void)
 {
-    int ret = register_filesystem(&naive_fs_type);
+    int ret = naive_sysfs_init();
     if (ret)
+        return ret;
+    
+    ret = register_filesystem(&naive_fs_type);
+    if (ret) {
         printk(KERN_ERR "naivefs: register failed, error %d\n", ret);
-    else
+        naive_sysfs_exit();
+    } else {
         printk(KERN_INFO "naivefs: register success\n");
+    }
     return ret;
 }
 
@@ -73,6 +123,7 @@ static int __init init_naivefs(void)
 static void __exit exit_naivefs(void)
 {
     unregister_filesystem(&naive_fs_type);
+    naive_sysfs_exit();
     printk(KERN_INFO "naivefs: unregistered\n");
 }
 
@@ -6,88 +6,993 @@
 #include <linux/slab.h>
 #include <linux/buffer_head.h>
 #include <linux/iversion.h>
+#include <linux/blkdev.h>
+
+#include "trace/events/naivefs.h"
 
 /* 块管理函数 */
 
-/* 查找空闲inode */
-int naive_find_free_inode(struct naive_sb_info *sbi)
-{
-    int i, j;
-    unsigned char *imap = sbi->inode_bitmap;
-    int total_inodes = le32_to_cpu(sbi->disk_sb->inode_total);
-    
-    for (i = 0; i < total_inodes / 8; i++) {
-        if (imap[i] != 0xFF) {
-            for (j = 0; j < 8; j++) {
-                if (!(imap[i] & (1 << j))) {
-                    int ino = i * 8 + j + 1;
-                    if (ino > total_inodes)
-                        return 0;
-                    return ino;
-                }
-            }
+/*
+ * 分配inode编号：在bitmap_lock下查找空闲位并置位，不同目录中的并发创建
+ * 不会得到同一个编号。返回0表示没有空闲inode；创建失败时由evict_inode
+ * 或naive_mark_inode_bitmap()释放编号。
+ */
+int naive_alloc_ino(struct naive_sb_info *sbi)
+{
+    unsigned long total = le32_to_cpu(sbi->disk_sb->inode_total);
+    unsigned long bit;
+    
+    spin_lock(&sbi->bitmap_lock);
+    bit = find_first_zero_bit_le(sbi->inode_bitmap, total);
+    if (bit < total) {
+        __set_bit_le(bit, sbi->inode_bitmap);
+        sbi->bitmap_dirty = true;
+    }
+    spin_unlock(&sbi->bitmap_lock);
+    return bit < total ? bit + 1 : 0;
+}
+
+/*
+ * 分配数据块：从goal开始查找空闲块，并尽量向后连续分配，最多count块。
+ * goal为0时按alloc=<policy>决定起点。返回实际分配的块数（至少1），
+ * *start为第一块的块号。连续的块在读写时可以合并成一个bio。
+ */
+int naive_alloc_blocks(struct naive_sb_info *sbi, unsigned long goal,
+                       unsigned int count, u32 *start)
+{
+    unsigned long total = le32_to_cpu(sbi->disk_sb->block_total);
+    unsigned long data_start = le32_to_cpu(sbi->disk_sb->data_block_no);
+    unsigned long block_no, scanned;
+    unsigned int n;
+    
+    total = min_t(unsigned long, total,
+                  sbi->block_bitmap_blocks * NAIVE_BLOCK_SIZE * 8);
+    
+    spin_lock(&sbi->bitmap_lock);
+    
+    /* next策略从上次分配位置继续，查到末尾后回绕 */
+    if (goal <= data_start || goal >= total) {
+        goal = data_start;
+        if (sbi->opts.alloc_policy == NAIVE_ALLOC_NEXT &&
+            sbi->alloc_cursor > data_start && sbi->alloc_cursor < total)
+            goal = sbi->alloc_cursor;
+    }
+    
+    block_no = find_next_zero_bit_le(sbi->block_bitmap, total, goal);
+    scanned = min(block_no, total) - goal;
+    if (block_no >= total && goal != data_start) {
+        block_no = find_next_zero_bit_le(sbi->block_bitmap, goal, data_start);
+        scanned += min(block_no, goal) - data_start;
+        if (block_no >= goal)
+            block_no = total;
+    }
+    
+    naive_stat_inc(sbi, NAIVE_STAT_ALLOC_SCANS);
+    naive_stat_add(sbi, NAIVE_STAT_ALLOC_SCANNED_BITS, scanned + 1);
+    
+    if (block_no >= total) {
+        spin_unlock(&sbi->bitmap_lock);
+        return -ENOSPC;
+    }
+    
+    for (n = 0; n < count && block_no + n < total &&
+                !test_bit_le(block_no + n, sbi->block_bitmap); n++) {
+        __set_bit_le(block_no + n, sbi->block_bitmap);
+        /* 重新使用的块不必再丢弃 */
+        __clear_bit_le(block_no + n, sbi->discard_bitmap);
+    }
+    sbi->alloc_cursor = block_no + n;
+    sbi->bitmap_dirty = true;
+    spin_unlock(&sbi->bitmap_lock);
+    
+    naive_stat_add(sbi, NAIVE_STAT_BLOCKS_ALLOCATED, n);
+    trace_naivefs_alloc_block(sbi->sb, block_no, n);
+    *start = block_no;
+    return n;
+}
+
+/* 分配单个数据块，返回块号 */
+int naive_alloc_block(struct naive_sb_info *sbi)
+{
+    u32 block_no;
+    int ret;
+    
+    ret = naive_alloc_blocks(sbi, 0, 1, &block_no);
+    if (ret < 0)
+        return ret;
+    return block_no;
+}
+
+/*
+ * 分配恰好count个连续的空闲块，供在线整理使用。从goal开始查找，查到末尾
+ * 后从数据区开头再查一遍；没有这么长的空闲段时返回-ENOSPC。
+ */
+int naive_alloc_run(struct naive_sb_info *sbi, unsigned long goal,
+                    unsigned int count, u32 *start)
+{
+    unsigned long total = le32_to_cpu(sbi->disk_sb->block_total);
+    unsigned long data_start = le32_to_cpu(sbi->disk_sb->data_block_no);
+    unsigned long pos, end, first, next, i;
+    int pass;
+    
+    total = min_t(unsigned long, total,
+                  sbi->block_bitmap_blocks * NAIVE_BLOCK_SIZE * 8);
+    if (goal < data_start || goal >= total)
+        goal = data_start;
+    
+    spin_lock(&sbi->bitmap_lock);
+    for (pass = 0; pass < 2; pass++) {
+        pos = pass ? data_start : goal;
+        end = pass ? goal : total;
+        while (pos < end) {
+            first = find_next_zero_bit_le(sbi->block_bitmap, end, pos);
+            if (first >= end)
+                break;
+            next = find_next_bit_le(sbi->block_bitmap, total, first);
+            if (next - first >= count)
+                goto found;
+            pos = next;
         }
     }
+    spin_unlock(&sbi->bitmap_lock);
+    return -ENOSPC;
+    
+found:
+    for (i = first; i < first + count; i++) {
+        __set_bit_le(i, sbi->block_bitmap);
+        __clear_bit_le(i, sbi->discard_bitmap);
+    }
+    sbi->bitmap_dirty = true;
+    spin_unlock(&sbi->bitmap_lock);
+    
+    naive_stat_add(sbi, NAIVE_STAT_BLOCKS_ALLOCATED, count);
+    trace_naivefs_alloc_block(sbi->sb, first, count);
+    *start = first;
     return 0;
 }
 
-/* 分配数据块 */
-int naive_alloc_block(struct naive_sb_info *sbi)
+/*
+ * 释放从block_no开始的count个连续数据块，整段只加一次锁；
+ * 共享的块只减引用计数。
+ */
+void naive_free_blocks(struct naive_sb_info *sbi, u32 block_no, unsigned int count)
+{
+    u32 total = sbi->block_bitmap_blocks * NAIVE_BLOCK_SIZE * 8;
+    unsigned int freed = 0;
+    unsigned int i;
+    
+    if (block_no >= total)
+        return;
+    count = min_t(u32, count, total - block_no);
+    
+    spin_lock(&sbi->bitmap_lock);
+    for (i = 0; i < count; i++) {
+        if (sbi->refcount && sbi->refcount[block_no + i]) {
+            sbi->refcount[block_no + i]--;
+            sbi->refcount_dirty = true;
+        } else {
+            __clear_bit_le(block_no + i, sbi->block_bitmap);
+            if (sbi->opts.discard)
+                __set_bit_le(block_no + i, sbi->discard_bitmap);
+            freed++;
+        }
+    }
+    if (freed) {
+        sbi->bitmap_dirty = true;
+        if (sbi->opts.discard)
+            sbi->discard_pending = true;
+    }
+    spin_unlock(&sbi->bitmap_lock);
+    
+    if (freed) {
+        naive_stat_add(sbi, NAIVE_STAT_BLOCKS_FREED, freed);
+        trace_naivefs_free_block(sbi->sb, block_no, count);
+    }
+}
+
+/* 释放单个数据块 */
+void naive_free_block(struct naive_sb_info *sbi, int block_no)
+{
+    naive_free_blocks(sbi, block_no, 1);
+}
+
+/* 为已分配的块增加一个引用（reflink） */
+int naive_ref_block(struct naive_sb_info *sbi, u32 block_no)
+{
+    int ret = 0;
+    
+    if (!sbi->refcount)
+        return -EOPNOTSUPP;
+    
+    spin_lock(&sbi->bitmap_lock);
+    if (sbi->refcount[block_no] >= NAIVE_REFCOUNT_MAX) {
+        ret = -EMLINK;
+    } else {
+        sbi->refcount[block_no]++;
+        sbi->refcount_dirty = true;
+    }
+    spin_unlock(&sbi->bitmap_lock);
+    return ret;
+}
+
+/*
+ * 从block_no开始的count个物理块中，返回与第一块共享状态相同的前缀长度，
+ * *shared为该前缀是否与其他文件共享。
+ */
+unsigned int naive_shared_extent(struct naive_sb_info *sbi, u32 block_no,
+                                 unsigned int count, bool *shared)
+{
+    unsigned int n = 1;
+    
+    *shared = false;
+    if (!sbi->refcount)
+        return count;
+    
+    spin_lock(&sbi->bitmap_lock);
+    *shared = sbi->refcount[block_no] != 0;
+    while (n < count && (sbi->refcount[block_no + n] != 0) == *shared)
+        n++;
+    spin_unlock(&sbi->bitmap_lock);
+    return n;
+}
+
+/* 标记inode位图 */
+void naive_mark_inode_bitmap(struct naive_sb_info *sbi, int ino, bool used)
+{
+    spin_lock(&sbi->bitmap_lock);
+    if (used)
+        __set_bit_le(ino - 1, sbi->inode_bitmap);
+    else
+        __clear_bit_le(ino - 1, sbi->inode_bitmap);
+    sbi->bitmap_dirty = true;
+    spin_unlock(&sbi->bitmap_lock);
+}
+
+/* ========== 丢弃（discard和FITRIM） ========== */
+
+/*
+ * 在[*pos, end)中找下一段至少minlen块的空闲区，pending为真时只找等待丢弃
+ * 的块。找到的块在位图中临时置位，丢弃期间不会被重新分配；返回块数，
+ * 没有时返回0。
+ */
+static u32 naive_reserve_free_run(struct naive_sb_info *sbi, unsigned long *pos,
+                                  unsigned long end, unsigned int minlen,
+                                  bool pending, u32 *start)
+{
+    unsigned long first, next, i;
+    u32 len = 0;
+    
+    spin_lock(&sbi->bitmap_lock);
+    while (*pos < end) {
+        if (pending) {
+            first = find_next_bit_le(sbi->discard_bitmap, end, *pos);
+            next = find_next_zero_bit_le(sbi->discard_bitmap, end, first);
+        } else {
+            first = find_next_zero_bit_le(sbi->block_bitmap, end, *pos);
+            next = find_next_bit_le(sbi->block_bitmap, end, first);
+        }
+        if (first >= end) {
+            *pos = end;
+            break;
+        }
+        next = min(next, first + NAIVE_DISCARD_MAX_RUN);
+        *pos = next;
+        if (next - first < minlen)
+            continue;
+        
+        /* 等待丢弃的块一定空闲：分配时会清除它们的丢弃标记 */
+        for (i = first; i < next; i++) {
+            __set_bit_le(i, sbi->block_bitmap);
+            __clear_bit_le(i, sbi->discard_bitmap);
+        }
+        *start = first;
+        len = next - first;
+        break;
+    }
+    spin_unlock(&sbi->bitmap_lock);
+    return len;
+}
+
+/* 丢弃占住的一段块，然后把它们还给位图 */
+static int naive_discard_run(struct naive_sb_info *sbi, u32 start, u32 len)
+{
+    int ret;
+    u32 i;
+    
+    ret = sb_issue_discard(sbi->sb, start, len, GFP_NOFS, 0);
+    
+    spin_lock(&sbi->bitmap_lock);
+    for (i = 0; i < len; i++)
+        __clear_bit_le(start + i, sbi->block_bitmap);
+    /* 占住期间可能有一次提交把这些块写成了已用 */
+    sbi->bitmap_dirty = true;
+    spin_unlock(&sbi->bitmap_lock);
+    
+    if (!ret)
+        naive_stat_add(sbi, NAIVE_STAT_BLOCKS_DISCARDED, len);
+    return ret;
+}
+
+/*
+ * 丢弃上次以来释放的块。在位图写回之后调用，相邻释放的块合并成一个
+ * 请求；释放和unlink本身不等待设备。
+ */
+void naive_issue_discards(struct super_block *sb)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    unsigned long total = min_t(unsigned long, le32_to_cpu(sbi->disk_sb->block_total),
+                                sbi->block_bitmap_blocks * NAIVE_BLOCK_SIZE * 8);
+    unsigned long pos = le32_to_cpu(sbi->disk_sb->data_block_no);
+    u32 start, len;
+    
+    if (!READ_ONCE(sbi->discard_pending))
+        return;
+    
+    mutex_lock(&sbi->discard_lock);
+    spin_lock(&sbi->bitmap_lock);
+    sbi->discard_pending = false;
+    spin_unlock(&sbi->bitmap_lock);
+    
+    while ((len = naive_reserve_free_run(sbi, &pos, total, 1, true, &start))) {
+        /* 设备不再支持丢弃（如换了底层设备）时放弃本轮 */
+        if (naive_discard_run(sbi, start, len) == -EOPNOTSUPP)
+            break;
+        cond_resched();
+    }
+    mutex_unlock(&sbi->discard_lock);
+}
+
+/*
+ * FITRIM：丢弃range内所有不短于minlen的空闲区，range->len返回丢弃的
+ * 字节数。按位图逐段占住、丢弃、归还，期间其他分配照常进行。
+ */
+int naive_trim_fs(struct super_block *sb, struct fstrim_range *range)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    unsigned long total = min_t(unsigned long, le32_to_cpu(sbi->disk_sb->block_total),
+                                sbi->block_bitmap_blocks * NAIVE_BLOCK_SIZE * 8);
+    unsigned long data_start = le32_to_cpu(sbi->disk_sb->data_block_no);
+    unsigned int granularity = bdev_discard_granularity(sb->s_bdev);
+    unsigned long pos, end;
+    u64 minlen, trimmed = 0;
+    u32 start, len;
+    int ret = 0;
+    
+    if (!bdev_max_discard_sectors(sb->s_bdev))
+        return -EOPNOTSUPP;
+    
+    minlen = DIV_ROUND_UP_ULL(max_t(u64, range->minlen, granularity),
+                              NAIVE_BLOCK_SIZE);
+    if (range->start >= (u64)total * NAIVE_BLOCK_SIZE ||
+        minlen > total - data_start)
+        return -EINVAL;
+    
+    pos = max_t(unsigned long, range->start / NAIVE_BLOCK_SIZE, data_start);
+    end = total;
+    if (range->len / NAIVE_BLOCK_SIZE < total - range->start / NAIVE_BLOCK_SIZE)
+        end = range->start / NAIVE_BLOCK_SIZE + range->len / NAIVE_BLOCK_SIZE;
+    
+    mutex_lock(&sbi->discard_lock);
+    while ((len = naive_reserve_free_run(sbi, &pos, end, minlen, false, &start))) {
+        ret = naive_discard_run(sbi, start, len);
+        if (ret)
+            break;
+        trimmed += len;
+        if (fatal_signal_pending(current)) {
+            ret = -ERESTARTSYS;
+            break;
+        }
+        cond_resched();
+    }
+    mutex_unlock(&sbi->discard_lock);
+    
+    range->len = trimmed * NAIVE_BLOCK_SIZE;
+    return trimmed ? 0 : ret;
+}
+
+/* 第i个块位图块的块号：第0块固定在NAIVE_BLOCK_BITMAP_BLOCK，其余在扩展区 */
+static u32 naive_bitmap_block(struct naive_sb_info *sbi, int i)
+{
+    return i ? sbi->bitmap_ext_block_no + i - 1 : NAIVE_BLOCK_BITMAP_BLOCK;
+}
+
+/* 第i个引用计数块的块号：mkfs建立的部分在原处，扩容增加的在扩展区 */
+static u32 naive_refcount_block(struct naive_sb_info *sbi, int i)
+{
+    if (i < sbi->refcount_base_blocks)
+        return sbi->refcount_block_no + i;
+    return sbi->refcount_ext_block_no + i - sbi->refcount_base_blocks;
+}
+
+/* 把内存中的一块位图或引用计数表复制到块bno并写出 */
+static int naive_write_meta_block(struct super_block *sb, u32 bno,
+                                  const void *src, int wait)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    struct buffer_head *bh = sb_bread(sb, bno);
+    int ret = 0;
+    
+    if (!bh)
+        return -EIO;
+    spin_lock(&sbi->bitmap_lock);
+    memcpy(bh->b_data, src, NAIVE_BLOCK_SIZE);
+    spin_unlock(&sbi->bitmap_lock);
+    mark_buffer_dirty(bh);
+    if (wait)
+        ret = sync_dirty_buffer(bh);
+    else
+        write_dirty_buffer(bh, 0);
+    brelse(bh);
+    return ret;
+}
+
+/* 把块引用计数表写回磁盘 */
+static int naive_commit_refcounts(struct super_block *sb, int wait)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    struct blk_plug plug;
+    int i, ret = 0;
+    
+    if (!sbi->refcount || !READ_ONCE(sbi->refcount_dirty))
+        return 0;
+    
+    spin_lock(&sbi->bitmap_lock);
+    sbi->refcount_dirty = false;
+    spin_unlock(&sbi->bitmap_lock);
+    
+    blk_start_plug(&plug);
+    for (i = 0; i < sbi->refcount_blocks; i++) {
+        ret = naive_write_meta_block(sb, naive_refcount_block(sbi, i),
+                                     sbi->refcount + i * NAIVE_BLOCK_SIZE, wait);
+        if (ret) {
+            WRITE_ONCE(sbi->refcount_dirty, true);
+            break;
+        }
+    }
+    blk_finish_plug(&plug);
+    return ret;
+}
+
+/* 调用者持有commit_lock，位图的大小和位置不会改变 */
+static int __naive_commit_bitmaps(struct super_block *sb, int wait)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    struct blk_plug plug;
+    int i, ret;
+    
+    if (!READ_ONCE(sbi->bitmap_dirty))
+        return naive_commit_refcounts(sb, wait);
+    
+    spin_lock(&sbi->bitmap_lock);
+    sbi->bitmap_dirty = false;
+    spin_unlock(&sbi->bitmap_lock);
+    
+    /* 块位图第0块和inode位图相邻，plug中合并成一个写请求 */
+    blk_start_plug(&plug);
+    ret = naive_write_meta_block(sb, NAIVE_BLOCK_BITMAP_BLOCK, sbi->block_bitmap, wait);
+    if (!ret)
+        ret = naive_write_meta_block(sb, NAIVE_INODE_BITMAP_BLOCK, sbi->inode_bitmap, wait);
+    for (i = 1; !ret && i < sbi->block_bitmap_blocks; i++)
+        ret = naive_write_meta_block(sb, naive_bitmap_block(sbi, i),
+                                     sbi->block_bitmap + i * NAIVE_BLOCK_SIZE, wait);
+    blk_finish_plug(&plug);
+    
+    if (ret) {
+        WRITE_ONCE(sbi->bitmap_dirty, true);
+        return ret;
+    }
+    return naive_commit_refcounts(sb, wait);
+}
+
+/* 把内存中的位图和块引用计数表写回磁盘 */
+int naive_commit_bitmaps(struct super_block *sb, int wait)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    int ret;
+    
+    mutex_lock(&sbi->commit_lock);
+    ret = __naive_commit_bitmaps(sb, wait);
+    mutex_unlock(&sbi->commit_lock);
+    return ret;
+}
+
+/* 周期提交：按commit=<秒>把位图刷回磁盘 */
+static void naive_commit_work(struct work_struct *work)
+{
+    struct naive_sb_info *sbi = container_of(to_delayed_work(work),
+                                             struct naive_sb_info, commit_work);
+    
+    if (!sb_rdonly(sbi->sb) && !naive_commit_bitmaps(sbi->sb, 0))
+        naive_issue_discards(sbi->sb);
+    
+    if (sbi->opts.commit_interval)
+        schedule_delayed_work(&sbi->commit_work,
+                              sbi->opts.commit_interval * HZ);
+}
+
+int naive_sync_fs(struct super_block *sb, int wait)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    int ret = naive_commit_bitmaps(sb, wait);
+    
+    /* 超级块只在孤儿链表头改变时变脏 */
+    if (!ret && wait && buffer_dirty(sbi->sb_bh))
+        ret = sync_dirty_buffer(sbi->sb_bh);
+    if (!ret && wait)
+        naive_issue_discards(sb);
+    return ret;
+}
+
+/* ========== 在线扩容 ========== */
+
+/*
+ * 在线扩容到new_total块，0表示扩到整个设备。块位图第0块和mkfs建立的
+ * 引用计数表留在原处，增加的位图块和引用计数块放在新增空间的开头（扩展
+ * 区），其余新增的块成为空闲块。新位图和引用计数表先同步写到扩展区，
+ * 最后写超级块切换：中途崩溃时旧超级块描述的布局仍然完整。上次扩容的
+ * 扩展区在切换之后释放。inode表大小不变。
+ */
+int naive_resize_fs(struct super_block *sb, u64 new_total)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    struct naive_super_block *nsb = sbi->disk_sb;
+    u64 dev_blocks = bdev_nr_bytes(sb->s_bdev) >> sb->s_blocksize_bits;
+    unsigned char *bitmap = NULL, *discard = NULL;
+    u32 old_total, ext, meta, i;
+    u32 old_bitmap_ext, old_bitmap_blocks, old_ref_ext, old_ref_ext_blocks;
+    int nbitmap, nref = 0, base;
+    u8 *refcount = NULL;
+    int ret = 0;
+    
+    if (!new_total)
+        new_total = dev_blocks;
+    /* 块指针的最高位是未写入标记 */
+    if (new_total > dev_blocks || new_total > NAIVE_BLOCK_UNWRITTEN)
+        return -EFBIG;
+    
+    mutex_lock(&sbi->commit_lock);
+    old_total = le32_to_cpu(nsb->block_total);
+    if (new_total <= old_total) {
+        /* 不支持缩小 */
+        ret = new_total == old_total ? 0 : -EINVAL;
+        goto out;
+    }
+    
+    nbitmap = DIV_ROUND_UP(new_total, NAIVE_BLOCK_SIZE * 8);
+    base = sbi->refcount_base_blocks;
+    if (sbi->refcount)
+        nref = DIV_ROUND_UP(new_total, NAIVE_BLOCK_SIZE);
+    meta = (nbitmap - 1) + (nref > base ? nref - base : 0);
+    ext = old_total;
+    if (meta >= new_total - old_total) {
+        ret = -ENOSPC;
+        goto out;
+    }
+    
+    bitmap = kvzalloc(nbitmap * NAIVE_BLOCK_SIZE, GFP_KERNEL);
+    discard = kvzalloc(nbitmap * NAIVE_BLOCK_SIZE, GFP_KERNEL);
+    if (nref)
+        refcount = kvzalloc(nref * NAIVE_BLOCK_SIZE, GFP_KERNEL);
+    if (!bitmap || !discard || (nref && !refcount)) {
+        ret = -ENOMEM;
+        goto out;
+    }
+    
+    /* 盘上的超级块仍描述旧布局，记下旧扩展区在切换后释放 */
+    old_bitmap_blocks = le32_to_cpu(nsb->block_bitmap_blocks) ?: 1;
+    old_bitmap_ext = le32_to_cpu(nsb->bitmap_ext_block_no);
+    old_ref_ext = le32_to_cpu(nsb->refcount_ext_block_no);
+    old_ref_ext_blocks = le32_to_cpu(nsb->refcount_base_blocks) ?
+                         le32_to_cpu(nsb->refcount_blocks) - base : 0;
+    
+    /* 换上更大的位图；block_total切换之前新增的块不会被分配 */
+    spin_lock(&sbi->bitmap_lock);
+    memcpy(bitmap, sbi->block_bitmap, sbi->block_bitmap_blocks * NAIVE_BLOCK_SIZE);
+    memcpy(discard, sbi->discard_bitmap, sbi->block_bitmap_blocks * NAIVE_BLOCK_SIZE);
+    if (refcount)
+        memcpy(refcount, sbi->refcount, sbi->refcount_blocks * NAIVE_BLOCK_SIZE);
+    for (i = ext; i < ext + meta; i++)
+        __set_bit_le(i, bitmap);
+    swap(sbi->block_bitmap, bitmap);
+    swap(sbi->discard_bitmap, discard);
+    sbi->block_bitmap_blocks = nbitmap;
+    sbi->bitmap_ext_block_no = nbitmap > 1 ? ext : 0;
+    if (refcount) {
+        swap(sbi->refcount, refcount);
+        sbi->refcount_blocks = nref;
+        sbi->refcount_ext_block_no = nref > base ? ext + nbitmap - 1 : 0;
+    }
+    sbi->bitmap_dirty = true;
+    sbi->refcount_dirty = true;
+    spin_unlock(&sbi->bitmap_lock);
+    
+    ret = __naive_commit_bitmaps(sb, 1);
+    if (ret)
+        goto out;
+    
+    spin_lock(&sbi->bitmap_lock);
+    nsb->block_bitmap_blocks = cpu_to_le32(sbi->block_bitmap_blocks);
+    nsb->bitmap_ext_block_no = cpu_to_le32(sbi->bitmap_ext_block_no);
+    if (sbi->refcount) {
+        nsb->refcount_blocks = cpu_to_le32(sbi->refcount_blocks);
+        nsb->refcount_base_blocks = cpu_to_le32(base);
+        nsb->refcount_ext_block_no = cpu_to_le32(sbi->refcount_ext_block_no);
+    }
+    nsb->features |= cpu_to_le32(NAIVE_FEATURE_META_EXT);
+    nsb->block_total = cpu_to_le32(new_total);
+    spin_unlock(&sbi->bitmap_lock);
+    mark_buffer_dirty(sbi->sb_bh);
+    ret = sync_dirty_buffer(sbi->sb_bh);
+    if (ret)
+        goto out;
+    
+    if (old_bitmap_ext)
+        naive_free_blocks(sbi, old_bitmap_ext, old_bitmap_blocks - 1);
+    if (old_ref_ext && old_ref_ext_blocks)
+        naive_free_blocks(sbi, old_ref_ext, old_ref_ext_blocks);
+    
+    printk(KERN_INFO "naivefs: %s: resized from %u to %llu blocks\n",
+           sb->s_id, old_total, new_total);
+    
+out:
+    mutex_unlock(&sbi->commit_lock);
+    kvfree(bitmap);
+    kvfree(discard);
+    kvfree(refcount);
+    return ret;
+}
+
+/* ========== 孤儿inode ========== */
+
+/*
+ * 最后一个链接被删除的inode加入孤儿链表。inode可能仍被打开，块和inode
+ * 编号在evict_inode中才释放。链表头在超级块中，经各inode的i_next_orphan
+ * 串起，崩溃后挂载时释放链表上剩下的inode，不需要全盘检查。
+ */
+void naive_orphan_add(struct inode *inode)
 {
-    int i, j;
-    unsigned char *bmap = sbi->block_bitmap;
-    int total_blocks = le32_to_cpu(sbi->disk_sb->block_total);
-    int data_start = le32_to_cpu(sbi->disk_sb->data_block_no);
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    struct naive_inode_info *nii = NAIVE_I(inode);
     
-    int start_byte = data_start / 8;
-    int start_bit = data_start % 8;
+    mutex_lock(&sbi->orphan_lock);
+    if (list_empty(&nii->i_orphan)) {
+        nii->i_next_orphan = le32_to_cpu(sbi->disk_sb->orphan_head);
+        list_add(&nii->i_orphan, &sbi->orphan_list);
+        sbi->disk_sb->orphan_head = cpu_to_le32(inode->i_ino);
+        mark_buffer_dirty(sbi->sb_bh);
+    }
+    mutex_unlock(&sbi->orphan_lock);
+    mark_inode_dirty(inode);
+}
+
+/* 从孤儿链表中摘下inode；前一个孤儿仍在内存中，直接改它的i_next_orphan */
+static void naive_orphan_del(struct inode *inode)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    struct naive_inode_info *prev;
     
-    for (i = start_byte; i < total_blocks / 8; i++) {
-        unsigned char byte = bmap[i];
-        int start = (i == start_byte) ? start_bit : 0;
+    mutex_lock(&sbi->orphan_lock);
+    if (!list_empty(&nii->i_orphan)) {
+        if (nii->i_orphan.prev == &sbi->orphan_list) {
+            sbi->disk_sb->orphan_head = cpu_to_le32(nii->i_next_orphan);
+            mark_buffer_dirty(sbi->sb_bh);
+        } else {
+            prev = list_prev_entry(nii, i_orphan);
+            prev->i_next_orphan = nii->i_next_orphan;
+            mark_inode_dirty(&prev->vfs_inode);
+        }
+        list_del_init(&nii->i_orphan);
+        nii->i_next_orphan = 0;
+    }
+    mutex_unlock(&sbi->orphan_lock);
+}
+
+/* ========== 后台回收 ========== */
+
+/*
+ * 已删除的大文件在最后一次iput时不立即逐出，而是留在inode缓存中交给
+ * 后台释放块，unlink不必等待逐块释放。inode一直在孤儿链表上，中途崩溃
+ * 后挂载时继续释放。在naive_drop_inode中调用，持有inode->i_lock。
+ */
+static bool naive_reclaim_queue(struct inode *inode)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    
+    /* 卸载时（SB_ACTIVE已清除）照常同步释放 */
+    if (inode->i_nlink || !sbi->opts.reclaim_blocks || READ_ONCE(sbi->reclaim_off) ||
+        READ_ONCE(nii->block_count) <= sbi->opts.reclaim_blocks ||
+        !(inode->i_sb->s_flags & SB_ACTIVE))
+        return false;
+    
+    spin_lock(&sbi->reclaim_lock);
+    if (list_empty(&nii->i_reclaim))
+        list_add_tail(&nii->i_reclaim, &sbi->reclaim_list);
+    spin_unlock(&sbi->reclaim_lock);
+    queue_work(system_unbound_wq, &sbi->reclaim_work);
+    return true;
+}
+
+static void naive_reclaim_work(struct work_struct *work)
+{
+    struct naive_sb_info *sbi = container_of(work, struct naive_sb_info, reclaim_work);
+    struct naive_inode_info *nii;
+    struct inode *inode;
+    int ret;
+    
+    for (;;) {
+        spin_lock(&sbi->reclaim_lock);
+        nii = list_first_entry_or_null(&sbi->reclaim_list,
+                                       struct naive_inode_info, i_reclaim);
+        if (nii)
+            list_del_init(&nii->i_reclaim);
+        rcu_read_lock();
+        spin_unlock(&sbi->reclaim_lock);
+        if (!nii) {
+            rcu_read_unlock();
+            break;
+        }
+        
+        /*
+         * drop_inode持有i_lock时取reclaim_lock，这里不能在reclaim_lock下
+         * igrab。inode在RCU宽限期后才释放；已被内存回收逐出时（块已由
+         * evict_inode同步释放）igrab返回NULL。
+         */
+        inode = igrab(&nii->vfs_inode);
+        rcu_read_unlock();
+        if (!inode)
+            continue;
         
-        for (j = start; j < 8; j++) {
-            if (!(byte & (1 << j))) {
-                int block_no = i * 8 + j;
-                if (block_no >= total_blocks)
-                    return -ENOSPC;
-                    
-                bmap[i] |= (1 << j);
-                return block_no;
+        /*
+         * 从末尾分批释放。每批之后同步写回缩短的块映射，崩溃后挂载时
+         * 孤儿链表上的inode不会再指向已释放的块。
+         */
+        for (;;) {
+            sector_t left = naive_free_tail_blocks(inode, NAIVE_RECLAIM_BATCH);
+            
+            ret = sync_mapping_buffers(inode->i_mapping);
+            if (!ret)
+                ret = write_inode_now(inode, 1);
+            if (ret) {
+                /* 写回出错时不再继续，也不再排队，iput时同步释放 */
+                printk(KERN_ERR "naivefs: %s: reclaim of inode %lu failed (%d), "
+                       "background reclaim disabled\n", inode->i_sb->s_id,
+                       inode->i_ino, ret);
+                WRITE_ONCE(sbi->reclaim_off, true);
+                break;
             }
+            if (!left)
+                break;
+            cond_resched();
         }
+        
+        /* 块已释放完，这次iput逐出inode，释放inode编号并移出孤儿链表 */
+        iput(inode);
     }
-    return -ENOSPC;
 }
 
-/* 释放数据块 */
-void naive_free_block(struct naive_sb_info *sbi, int block_no)
+/* 卸载前等待后台回收结束，否则它持有的inode引用会阻止逐出 */
+void naive_kill_sb(struct super_block *sb)
+{
+    if (sb->s_fs_info)
+        flush_work(&NAIVE_SB(sb)->reclaim_work);
+    kill_block_super(sb);
+}
+
+/*
+ * 以读写方式挂载（或从只读remount为读写）时释放上次卸载前没来得及释放
+ * 的孤儿inode。remount时s_flags在reconfigure返回后才更新，由调用者判断
+ * 是否可写。
+ *
+ * 沿i_next_orphan遍历链表，不反复读链表头：仍在内存中的inode不会在iput时
+ * 逐出，链表头也就不会前进。清理期间不使用后台回收，其余inode在iput时
+ * 同步释放。
+ */
+static void naive_orphan_cleanup(struct super_block *sb)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    u32 inode_total = le32_to_cpu(sbi->disk_sb->inode_total);
+    struct naive_inode_info *nii;
+    struct inode *inode;
+    unsigned int nr = 0;
+    bool reclaim_off;
+    u32 ino;
+    
+    reclaim_off = READ_ONCE(sbi->reclaim_off);
+    WRITE_ONCE(sbi->reclaim_off, true);
+    
+    mutex_lock(&sbi->orphan_lock);
+    ino = le32_to_cpu(sbi->disk_sb->orphan_head);
+    mutex_unlock(&sbi->orphan_lock);
+    
+    while (ino) {
+        /* 链表上的inode必须仍在使用中，否则链表已损坏（或成环） */
+        if (ino <= inode_total && nr < inode_total &&
+            test_bit_le(ino - 1, sbi->inode_bitmap))
+            inode = naive_iget(sb, ino);
+        else
+            inode = ERR_PTR(-EINVAL);
+        if (IS_ERR(inode)) {
+            /* 在前一个仍在链表上的inode（或链表头）处截断 */
+            printk(KERN_ERR "naivefs: bad orphan list at inode %u, dropped\n", ino);
+            mutex_lock(&sbi->orphan_lock);
+            if (list_empty(&sbi->orphan_list)) {
+                sbi->disk_sb->orphan_head = 0;
+                mark_buffer_dirty(sbi->sb_bh);
+            } else {
+                nii = list_last_entry(&sbi->orphan_list, struct naive_inode_info,
+                                      i_orphan);
+                nii->i_next_orphan = 0;
+                mark_inode_dirty(&nii->vfs_inode);
+            }
+            mutex_unlock(&sbi->orphan_lock);
+            break;
+        }
+        nr++;
+        
+        /* 按磁盘上的顺序接到内存链表末尾；已在链表上的inode不再加入 */
+        nii = NAIVE_I(inode);
+        mutex_lock(&sbi->orphan_lock);
+        if (list_empty(&nii->i_orphan))
+            list_add_tail(&nii->i_orphan, &sbi->orphan_list);
+        ino = nii->i_next_orphan;
+        mutex_unlock(&sbi->orphan_lock);
+        
+        /* 链接数不为0的inode不该在链表上，只摘下不释放 */
+        if (inode->i_nlink)
+            naive_orphan_del(inode);
+        
+        /* 链接数为0，最后一次iput经evict_inode释放并从链表中摘下 */
+        iput(inode);
+    }
+    
+    WRITE_ONCE(sbi->reclaim_off, reclaim_off);
+    
+    if (nr)
+        printk(KERN_INFO "naivefs: %s: cleaned up %u orphan inodes\n",
+               sb->s_id, nr);
+}
+
+/* 把块位图读入内存，同时分配同样大小的丢弃位图 */
+static int naive_load_block_bitmap(struct super_block *sb)
 {
-    int i = block_no / 8;
-    int j = block_no % 8;
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    struct naive_super_block *nsb = sbi->disk_sb;
+    int i, ret = -ENOMEM;
     
-    if (i < sbi->block_bitmap_blocks * NAIVE_BLOCK_SIZE) {
-        sbi->block_bitmap[i] &= ~(1 << j);
+    sbi->block_bitmap_blocks = le32_to_cpu(nsb->block_bitmap_blocks) ?: 1;
+    sbi->bitmap_ext_block_no = le32_to_cpu(nsb->bitmap_ext_block_no);
+    if ((sbi->block_bitmap_blocks > 1 && !sbi->bitmap_ext_block_no) ||
+        sbi->block_bitmap_blocks > DIV_ROUND_UP(le32_to_cpu(nsb->block_total),
+                                                NAIVE_BLOCK_SIZE * 8)) {
+        printk(KERN_ERR "naivefs: bad block bitmap layout\n");
+        return -EINVAL;
+    }
+    
+    sbi->block_bitmap = kvmalloc(sbi->block_bitmap_blocks * NAIVE_BLOCK_SIZE, GFP_KERNEL);
+    /* remount时可以打开discard，丢弃位图总是分配 */
+    sbi->discard_bitmap = kvzalloc(sbi->block_bitmap_blocks * NAIVE_BLOCK_SIZE, GFP_KERNEL);
+    if (!sbi->block_bitmap || !sbi->discard_bitmap)
+        goto fail;
+    
+    for (i = 0; i < sbi->block_bitmap_blocks; i++) {
+        struct buffer_head *bh = sb_bread(sb, naive_bitmap_block(sbi, i));
+        
+        if (!bh) {
+            ret = -EIO;
+            goto fail;
+        }
+        memcpy(sbi->block_bitmap + i * NAIVE_BLOCK_SIZE, bh->b_data, NAIVE_BLOCK_SIZE);
+        brelse(bh);
+    }
+    return 0;
+    
+fail:
+    kvfree(sbi->block_bitmap);
+    kvfree(sbi->discard_bitmap);
+    sbi->block_bitmap = NULL;
+    sbi->discard_bitmap = NULL;
+    return ret;
+}
+
+/* 启用reflink时把块引用计数表读入内存 */
+static int naive_load_refcounts(struct super_block *sb)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    struct naive_super_block *nsb = sbi->disk_sb;
+    int i;
+    
+    if (!naive_has_feature(sbi, NAIVE_FEATURE_REFLINK))
+        return 0;
+    
+    /* 没有扩容过的文件系统整张表都在refcount_block_no处 */
+    sbi->refcount_block_no = le32_to_cpu(nsb->refcount_block_no);
+    sbi->refcount_blocks = le32_to_cpu(nsb->refcount_blocks);
+    sbi->refcount_base_blocks = le32_to_cpu(nsb->refcount_base_blocks) ?: sbi->refcount_blocks;
+    sbi->refcount_ext_block_no = le32_to_cpu(nsb->refcount_ext_block_no);
+    if (!sbi->refcount_block_no || (u64)sbi->refcount_blocks * NAIVE_BLOCK_SIZE <
+                  min_t(u64, le32_to_cpu(nsb->block_total),
+                        sbi->block_bitmap_blocks * NAIVE_BLOCK_SIZE * 8) ||
+        sbi->refcount_base_blocks > sbi->refcount_blocks ||
+        (sbi->refcount_base_blocks < sbi->refcount_blocks && !sbi->refcount_ext_block_no)) {
+        printk(KERN_ERR "naivefs: refcount table too small\n");
+        return -EINVAL;
+    }
+    
+    sbi->refcount = kvmalloc(sbi->refcount_blocks * NAIVE_BLOCK_SIZE, GFP_KERNEL);
+    if (!sbi->refcount)
+        return -ENOMEM;
+    
+    for (i = 0; i < sbi->refcount_blocks; i++) {
+        struct buffer_head *bh = sb_bread(sb, naive_refcount_block(sbi, i));
+        
+        if (!bh) {
+            kvfree(sbi->refcount);
+            sbi->refcount = NULL;
+            return -EIO;
+        }
+        memcpy(sbi->refcount + i * NAIVE_BLOCK_SIZE, bh->b_data, NAIVE_BLOCK_SIZE);
+        brelse(bh);
+    }
+    return 0;
+}
+
+/* 设备不支持丢弃时忽略discard选项 */
+static void naive_check_discard(struct super_block *sb, struct naive_mount_opts *opts)
+{
+    if (opts->discard && !bdev_max_discard_sectors(sb->s_bdev)) {
+        printk(KERN_WARNING "naivefs: %s: device does not support discard, option ignored\n",
+               sb->s_id);
+        opts->discard = 0;
     }
 }
 
 /* 填充超级块 */
-int naive_fill_super(struct super_block *sb, void *data, int silent)
+int naive_fill_super(struct super_block *sb, struct fs_context *fc)
 {
+    struct naive_mount_opts *opts = fc->fs_private;
+    int silent = fc->sb_flags & SB_SILENT;
     struct naive_sb_info *sbi;
     struct buffer_head *bh;
     struct naive_super_block *nsb;
     struct inode *root_inode;
     int ret = 0;
     
-    printk(KERN_INFO "naivefs: filling super block\n");
-    
     sbi = kzalloc(sizeof(struct naive_sb_info), GFP_KERNEL);
     if (!sbi)
         return -ENOMEM;
     
+    sbi->sb = sb;
+    sbi->opts = *opts;
+    spin_lock_init(&sbi->bitmap_lock);
+    mutex_init(&sbi->discard_lock);
+    mutex_init(&sbi->commit_lock);
+    INIT_DELAYED_WORK(&sbi->commit_work, naive_commit_work);
+    atomic_set(&sbi->nr_inodes, 0);
+    INIT_LIST_HEAD(&sbi->orphan_list);
+    mutex_init(&sbi->orphan_lock);
+    INIT_LIST_HEAD(&sbi->reclaim_list);
+    spin_lock_init(&sbi->reclaim_lock);
+    INIT_WORK(&sbi->reclaim_work, naive_reclaim_work);
     sb->s_fs_info = sbi;
     
+    sbi->stats = alloc_percpu(struct naive_stats);
+    if (!sbi->stats) {
+        ret = -ENOMEM;
+        goto free_sbi;
+    }
+    
+    naive_debug(sb, 1, "filling super block for %s\n", sb->s_id);
+    
+    /* get_tree_bdev按设备块大小建立超级块，这里切换到512字节 */
+    if (!sb_set_blocksize(sb, NAIVE_BLOCK_SIZE)) {
+        printk(KERN_ERR "naivefs: unable to set block size %d\n",
+               NAIVE_BLOCK_SIZE);
+        ret = -EINVAL;
+        goto free_sbi;
+    }
+    
     /* 读取超级块 */
     bh = sb_bread(sb, NAIVE_SUPER_BLOCK_BLOCK);
     if (!bh) {
@@ -102,98 +1007,107 @@ int naive_fill_super(struct super_block *sb, void *data, int silent)
     sbi->sb_bh = bh;
     
     /* 验证魔数 */
-    printk(KERN_INFO "naivefs: read magic: 0x%x\n", le32_to_cpu(nsb->magic));
-    printk(KERN_INFO "naivefs: expected magic: 0x%x\n", NAIVE_MAGIC);
-    
     if (le32_to_cpu(nsb->magic) != NAIVE_MAGIC) {
-        printk(KERN_ERR "naivefs: wrong magic number (0x%x != 0x%x)\n",
-               le32_to_cpu(nsb->magic), NAIVE_MAGIC);
+        if (!silent)
+            printk(KERN_ERR "naivefs: wrong magic number (0x%x != 0x%x)\n",
+                   le32_to_cpu(nsb->magic), NAIVE_MAGIC);
         ret = -EINVAL;
         goto release_sb_bh;
     }
     
-    printk(KERN_INFO "naivefs: magic number OK\n");
+    if (le32_to_cpu(nsb->features) & ~NAIVE_FEATURE_SUPPORTED) {
+        printk(KERN_ERR "naivefs: unsupported features 0x%x\n",
+               le32_to_cpu(nsb->features) & ~NAIVE_FEATURE_SUPPORTED);
+        ret = -EINVAL;
+        goto release_sb_bh;
+    }
     
     /* 设置超级块属性 */
     sb->s_magic = NAIVE_MAGIC;
-    sb->s_blocksize = NAIVE_BLOCK_SIZE;
-    sb->s_blocksize_bits = 9;
     sb->s_maxbytes = NAIVE_MAX_FILE_SIZE;
     sb->s_op = &naive_sops;
     
     /* 读取数据块位图 */
-    bh = sb_bread(sb, 2); /* 数据块位图 */
-    if (!bh) {
-        ret = -EIO;
+    ret = naive_load_block_bitmap(sb);
+    if (ret)
         goto release_sb_bh;
-    }
-    sbi->block_bitmap = kmalloc(NAIVE_BLOCK_SIZE, GFP_KERNEL);
-    if (!sbi->block_bitmap) {
-        ret = -ENOMEM;
-        goto release_bh;
-    }
-    memcpy(sbi->block_bitmap, bh->b_data, NAIVE_BLOCK_SIZE);
-    sbi->block_bitmap_blocks = 1;
-    brelse(bh);
+    naive_check_discard(sb, &sbi->opts);
     
     /* 读取inode位图 */
-    bh = sb_bread(sb, 3); /* inode位图 */
+    bh = sb_bread(sb, NAIVE_INODE_BITMAP_BLOCK);
     if (!bh) {
         ret = -EIO;
         goto free_block_bitmap;
     }
     sbi->inode_bitmap = kmalloc(NAIVE_BLOCK_SIZE, GFP_KERNEL);
     if (!sbi->inode_bitmap) {
+        brelse(bh);
         ret = -ENOMEM;
-        goto release_bh2;
+        goto free_block_bitmap;
     }
     memcpy(sbi->inode_bitmap, bh->b_data, NAIVE_BLOCK_SIZE);
     sbi->inode_bitmap_blocks = 1;
     brelse(bh);
     
-    /* 创建根inode */
-    root_inode = naive_alloc_inode(sb);
-    if (!root_inode) {
-        ret = -ENOMEM;
+    ret = naive_load_refcounts(sb);
+    if (ret)
         goto free_inode_bitmap;
-    }
     
-    root_inode->i_ino = NAIVE_ROOT_INODE_NO;
-    root_inode->i_sb = sb;
-    root_inode->i_op = &naive_dir_iops;
-    root_inode->i_fop = &simple_dir_operations;
-    root_inode->i_mode = S_IFDIR | 0755;
+    ret = naive_xattr_init(sb);
+    if (ret)
+        goto free_refcounts;
     
-    /* 设置时间 */
-    struct timespec64 ts;
-    ktime_get_real_ts64(&ts);
-    inode_set_atime_to_ts(root_inode, ts);
-    inode_set_mtime_to_ts(root_inode, ts);
-    inode_set_ctime_to_ts(root_inode, ts);
+    ret = naive_register_sysfs(sb);
+    if (ret)
+        goto exit_xattr;
     
-    set_nlink(root_inode, 2); /* . 和 .. */
+    /* 从磁盘读入根inode，mkfs.naive已写好 */
+    root_inode = naive_iget(sb, NAIVE_ROOT_INODE_NO);
+    if (IS_ERR(root_inode)) {
+        ret = PTR_ERR(root_inode);
+        goto unregister_sysfs;
+    }
+    if (!S_ISDIR(root_inode->i_mode)) {
+        printk(KERN_ERR "naivefs: root inode is not a directory\n");
+        iput(root_inode);
+        ret = -EINVAL;
+        goto unregister_sysfs;
+    }
     
     /* 创建根dentry */
     sb->s_root = d_make_root(root_inode);
     if (!sb->s_root) {
         ret = -ENOMEM;
-        goto free_inode_bitmap;
+        goto unregister_sysfs;
     }
     
-    printk(KERN_INFO "naivefs: fill_super success\n");
+    /* 释放上次崩溃时仍在孤儿链表上的inode；只读挂载时留到remount为读写 */
+    if (!sb_rdonly(sb))
+        naive_orphan_cleanup(sb);
+    
+    if (!sb_rdonly(sb) && sbi->opts.commit_interval)
+        schedule_delayed_work(&sbi->commit_work,
+                              sbi->opts.commit_interval * HZ);
+    
+    naive_debug(sb, 1, "fill_super success\n");
     return 0;
     
+unregister_sysfs:
+    naive_unregister_sysfs(sb);
+exit_xattr:
+    naive_xattr_exit(sb);
+free_refcounts:
+    kvfree(sbi->refcount);
 free_inode_bitmap:
     kfree(sbi->inode_bitmap);
-release_bh2:
-    brelse(bh);
 free_block_bitmap:
-    kfree(sbi->block_bitmap);
-release_bh:
-    brelse(bh);
+    kvfree(sbi->discard_bitmap);
+    kvfree(sbi->block_bitmap);
 release_sb_bh:
     brelse(sbi->sb_bh);
 free_sbi:
+    free_percpu(sbi->stats);
+    sb->s_fs_info = NULL;
     kfree(sbi);
     return ret;
 }
@@ -204,13 +1118,20 @@ void naive_put_super(struct super_block *sb)
     struct naive_sb_info *sbi = NAIVE_SB(sb);
     
     if (sbi) {
-        kfree(sbi->block_bitmap);
+        cancel_delayed_work_sync(&sbi->commit_work);
+        if (!sb_rdonly(sb))
+            naive_commit_bitmaps(sb, 1);
+        naive_unregister_sysfs(sb);
+        naive_xattr_exit(sb);
+        free_percpu(sbi->stats);
+        kvfree(sbi->block_bitmap);
+        kvfree(sbi->discard_bitmap);
         kfree(sbi->inode_bitmap);
+        kvfree(sbi->refcount);
         brelse(sbi->sb_bh);
         kfree(sbi);
         sb->s_fs_info = NULL;
     }
-    printk(KERN_INFO "naivefs: put_super called\n");
 }
 
 /* 分配inode */
@@ -223,16 +1144,40 @@ struct inode *naive_alloc_inode(struct super_block *sb)
         return NULL;
     
     memset(nii, 0, sizeof(struct naive_inode_info));
+    mutex_init(&nii->block_lock);
+    init_rwsem(&nii->xattr_sem);
+    INIT_LIST_HEAD(&nii->i_orphan);
+    INIT_LIST_HEAD(&nii->i_reclaim);
+    spin_lock_init(&nii->ioend_lock);
+    INIT_LIST_HEAD(&nii->ioend_list);
+    INIT_WORK(&nii->ioend_work, naive_end_io_work);
+    inode_init_once(&nii->vfs_inode);
+    atomic_inc(&NAIVE_SB(sb)->nr_inodes);
     return &nii->vfs_inode;
 }
 
-/* 销毁inode */
-void naive_destroy_inode(struct inode *inode)
+/* 释放inode：在RCU宽限期之后调用，RCU路径查找仍可能读取快速符号链接的i_link */
+void naive_free_inode(struct inode *inode)
 {
     struct naive_inode_info *nii = NAIVE_I(inode);
+    
+    atomic_dec(&NAIVE_SB(inode->i_sb)->nr_inodes);
+    kfree(nii->inline_data);
     kfree(nii);
 }
 
+/* 内存中的inode超过icache=<n>时不再缓存最后一个引用释放的inode */
+int naive_drop_inode(struct inode *inode)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    
+    if (naive_reclaim_queue(inode))
+        return 0;
+    if (atomic_read(&sbi->nr_inodes) > sbi->opts.icache_size)
+        return 1;
+    return generic_drop_inode(inode);
+}
+
 /* 写入inode */
 int naive_write_inode(struct inode *inode, struct writeback_control *wbc)
 {
@@ -242,12 +1187,13 @@ int naive_write_inode(struct inode *inode, struct writeback_control *wbc)
     struct buffer_head *bh;
     struct naive_inode *disk_inode;
     int inode_table_start = le32_to_cpu(sbi->disk_sb->inode_table_block_no);
-    
-    printk(KERN_INFO "naivefs: write_inode called for inode %lu\n", inode->i_ino);
+    int ret = 0;
     
     bh = sb_bread(sb, inode_table_start + (inode->i_ino - 1));
-    if (!bh)
+    if (!bh) {
+        trace_naivefs_write_inode(inode, -EIO);
         return -EIO;
+    }
     
     disk_inode = (struct naive_inode *)bh->b_data;
     
@@ -256,9 +1202,18 @@ int naive_write_inode(struct inode *inode, struct writeback_control *wbc)
     disk_inode->i_ino = cpu_to_le32(inode->i_ino);
     disk_inode->block_count = cpu_to_le32(nii->block_count);
     
-    for (int i = 0; i < nii->block_count; i++) {
+    for (int i = 0; i < min(nii->block_count, NAIVE_BLOCK_PER_FILE); i++) {
         disk_inode->block[i] = cpu_to_le32(nii->block_pointers[i]);
     }
+    disk_inode->i_ind_block = cpu_to_le32(nii->i_ind_block);
+    disk_inode->i_dind_block = cpu_to_le32(nii->i_dind_block);
+    disk_inode->i_blocks = cpu_to_le32(inode->i_blocks);
+    
+    down_read(&nii->xattr_sem);
+    disk_inode->i_xattr_block = cpu_to_le32(nii->i_xattr_block);
+    memcpy(disk_inode->i_xattr, nii->i_xattr, NAIVE_INODE_XATTR_SIZE);
+    up_read(&nii->xattr_sem);
+    disk_inode->i_next_orphan = cpu_to_le32(nii->i_next_orphan);
     
     if (S_ISDIR(inode->i_mode)) {
         disk_inode->dir_children_count = cpu_to_le32(inode->i_size / NAIVE_DIR_RECORD_SIZE);
@@ -269,6 +1224,9 @@ int naive_write_inode(struct inode *inode, struct writeback_control *wbc)
     disk_inode->i_uid = cpu_to_le32(i_uid_read(inode));
     disk_inode->i_gid = cpu_to_le32(i_gid_read(inode));
     disk_inode->i_nlink = cpu_to_le32(inode->i_nlink);
+    disk_inode->i_flags = cpu_to_le32(nii->i_flags);
+    if (nii->i_flags & NAIVE_INODE_INLINE_DATA)
+        memcpy(disk_inode->i_inline, nii->inline_data, NAIVE_INLINE_SIZE);
     
     /* 使用正确的时间访问函数 */
     struct timespec64 atime = inode_get_atime(inode);
@@ -280,16 +1238,217 @@ int naive_write_inode(struct inode *inode, struct writeback_control *wbc)
     disk_inode->i_ctime = cpu_to_le32(ctime.tv_sec);
     
     mark_buffer_dirty(bh);
+    /* fsync、write_inode_now(inode, 1)等要求inode写到磁盘后才返回 */
+    if (wbc->sync_mode == WB_SYNC_ALL)
+        ret = sync_dirty_buffer(bh);
     brelse(bh);
     
-    return 0;
+    naive_stat_inc(sbi, NAIVE_STAT_INODE_WRITES);
+    trace_naivefs_write_inode(inode, ret);
+    return ret;
 }
 
 /* 清除inode */
 void naive_evict_inode(struct inode *inode)
 {
-    printk(KERN_INFO "naivefs: evict_inode called for inode %lu\n", inode->i_ino);
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    struct naive_inode_info *nii = NAIVE_I(inode);
     
     truncate_inode_pages_final(&inode->i_data);
+    /* 回写已结束，但完成处理的work可能还没返回 */
+    flush_work(&nii->ioend_work);
+    /* 等待后台回收时被内存回收逐出：不再由后台处理 */
+    spin_lock(&sbi->reclaim_lock);
+    list_del_init(&nii->i_reclaim);
+    spin_unlock(&sbi->reclaim_lock);
+    /* 最后一个链接已删除且不再被打开：现在释放块和inode编号 */
+    if (!inode->i_nlink && !is_bad_inode(inode)) {
+        naive_delete_inode(inode);
+        naive_orphan_del(inode);
+    }
+    /* 间接块的脏缓冲区留给块设备回写，这里只断开与inode的关联 */
+    invalidate_inode_buffers(inode);
+    naive_bmap_release(inode);
     clear_inode(inode);
 }
+
+/* ========== 挂载选项（fs_context） ========== */
+
+enum {
+    Opt_commit,
+    Opt_alloc,
+    Opt_ra,
+    Opt_icache,
+    Opt_atime,
+    Opt_debug,
+    Opt_reclaim,
+    Opt_discard,
+};
+
+static const struct constant_table naive_param_alloc[] = {
+    { "first",  NAIVE_ALLOC_FIRST },
+    { "next",   NAIVE_ALLOC_NEXT },
+    {}
+};
+
+static const struct constant_table naive_param_atime[] = {
+    { "none",   NAIVE_ATIME_NONE },
+    { "lazy",   NAIVE_ATIME_LAZY },
+    { "strict", NAIVE_ATIME_STRICT },
+    {}
+};
+
+const struct fs_parameter_spec naive_fs_parameters[] = {
+    fsparam_u32     ("commit",  Opt_commit),
+    fsparam_enum    ("alloc",   Opt_alloc, naive_param_alloc),
+    fsparam_u32     ("ra",      Opt_ra),
+    fsparam_u32     ("icache",  Opt_icache),
+    fsparam_enum    ("atime",   Opt_atime, naive_param_atime),
+    fsparam_u32     ("debug",   Opt_debug),
+    fsparam_u32     ("reclaim", Opt_reclaim),
+    fsparam_flag_no ("discard", Opt_discard),
+    {}
+};
+
+/* /proc/mounts中显示所有可调参数 */
+int naive_show_options(struct seq_file *seq, struct dentry *root)
+{
+    struct naive_mount_opts *opts = &NAIVE_SB(root->d_sb)->opts;
+    
+    seq_printf(seq, ",commit=%u", opts->commit_interval);
+    seq_printf(seq, ",alloc=%s", naive_param_alloc[opts->alloc_policy].name);
+    seq_printf(seq, ",ra=%u", opts->ra_blocks);
+    seq_printf(seq, ",icache=%u", opts->icache_size);
+    seq_printf(seq, ",atime=%s", naive_param_atime[opts->atime_mode].name);
+    seq_printf(seq, ",reclaim=%u", opts->reclaim_blocks);
+    if (opts->discard)
+        seq_puts(seq, ",discard");
+    if (opts->debug)
+        seq_printf(seq, ",debug=%u", opts->debug);
+    return 0;
+}
+
+static int naive_parse_param(struct fs_context *fc, struct fs_parameter *param)
+{
+    struct naive_mount_opts *opts = fc->fs_private;
+    struct fs_parse_result result;
+    int opt;
+    
+    opt = fs_parse(fc, naive_fs_parameters, param, &result);
+    if (opt < 0)
+        return opt;
+    
+    switch (opt) {
+    case Opt_commit:
+        opts->commit_interval = result.uint_32;
+        break;
+    case Opt_alloc:
+        opts->alloc_policy = result.uint_32;
+        break;
+    case Opt_ra:
+        if (result.uint_32 > NAIVE_MAX_RA_BLOCKS)
+            return invalfc(fc, "ra must be at most %u blocks", NAIVE_MAX_RA_BLOCKS);
+        opts->ra_blocks = result.uint_32;
+        break;
+    case Opt_icache:
+        opts->icache_size = result.uint_32;
+        break;
+    case Opt_atime:
+        opts->atime_mode = result.uint_32;
+        break;
+    case Opt_debug:
+        opts->debug = result.uint_32;
+        break;
+    case Opt_reclaim:
+        opts->reclaim_blocks = result.uint_32;
+        break;
+    case Opt_discard:
+        opts->discard = !result.negated;
+        break;
+    default:
+        return -EINVAL;
+    }
+    return 0;
+}
+
+static int naive_get_tree(struct fs_context *fc)
+{
+    return get_tree_bdev(fc, naive_fill_super);
+}
+
+/*
+ * mount -o remount：整体替换选项并按新间隔重新安排提交。转为只读时写出
+ * 位图、超级块和等待的丢弃，之后不再提交；转为读写时先释放只读期间
+ * 留下的孤儿inode，再恢复周期提交。
+ */
+static int naive_reconfigure(struct fs_context *fc)
+{
+    struct super_block *sb = fc->root->d_sb;
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    struct naive_mount_opts *opts = fc->fs_private;
+    bool rdonly = fc->sb_flags & SB_RDONLY;
+    int ret = 0;
+    
+    flush_work(&sbi->reclaim_work);
+    sync_filesystem(sb);
+    cancel_delayed_work_sync(&sbi->commit_work);
+    naive_check_discard(sb, opts);
+    
+    spin_lock(&sbi->bitmap_lock);
+    sbi->opts = *opts;
+    spin_unlock(&sbi->bitmap_lock);
+    
+    if (rdonly && !sb_rdonly(sb)) {
+        ret = naive_sync_fs(sb, 1);
+        /* 写出失败时保持读写 */
+        if (ret)
+            rdonly = false;
+    } else if (!rdonly && sb_rdonly(sb)) {
+        naive_orphan_cleanup(sb);
+    }
+    
+    if (!rdonly && sbi->opts.commit_interval)
+        schedule_delayed_work(&sbi->commit_work,
+                              sbi->opts.commit_interval * HZ);
+    
+    naive_debug(sb, 1, "remounted %s\n", sb->s_id);
+    return ret;
+}
+
+static void naive_free_fc(struct fs_context *fc)
+{
+    kfree(fc->fs_private);
+}
+
+static const struct fs_context_operations naive_context_ops = {
+    .parse_param    = naive_parse_param,
+    .get_tree       = naive_get_tree,
+    .reconfigure    = naive_reconfigure,
+    .free           = naive_free_fc,
+};
+
+int naive_init_fs_context(struct fs_context *fc)
+{
+    struct naive_mount_opts *opts;
+    
+    opts = kzalloc(sizeof(struct naive_mount_opts), GFP_KERNEL);
+    if (!opts)
+        return -ENOMEM;
+    
+    if (fc->purpose == FS_CONTEXT_FOR_RECONFIGURE) {
+        /* remount时未指定的选项保持原值 */
+        *opts = NAIVE_SB(fc->root->d_sb)->opts;
+    } else {
+        opts->commit_interval = NAIVE_DEFAULT_COMMIT_INTERVAL;
+        opts->alloc_policy = NAIVE_ALLOC_FIRST;
+        opts->ra_blocks = NAIVE_DEFAULT_RA_BLOCKS;
+        opts->icache_size = NAIVE_DEFAULT_ICACHE_SIZE;
+        opts->atime_mode = NAIVE_ATIME_LAZY;
+        opts->debug = 0;
+        opts->reclaim_blocks = NAIVE_DEFAULT_RECLAIM_BLOCKS;
+    }
+    
+    fc->fs_private = opts;
+    fc->ops = &naive_context_ops;
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include "naivefs.h"
+
+#include <linux/sysfs.h>
+#include <linux/cpumask.h>
+
+/* /sys/fs/naive */
+static struct kset *naive_kset;
+
+struct naive_attr {
+    struct attribute attr;
+    int item;
+    ssize_t (*show)(struct naive_sb_info *sbi, struct naive_attr *a, char *buf);
+};
+
+static u64 naive_stat_sum(struct naive_sb_info *sbi, int item)
+{
+    u64 sum = 0;
+    int cpu;
+    
+    for_each_possible_cpu(cpu)
+        sum += per_cpu_ptr(sbi->stats, cpu)->count[item];
+    return sum;
+}
+
+static ssize_t naive_counter_show(struct naive_sb_info *sbi,
+                                  struct naive_attr *a, char *buf)
+{
+    return sysfs_emit(buf, "%llu\n", naive_stat_sum(sbi, a->item));
+}
+
+/* 每行一个桶："<下限>-<上限>us <次数>" */
+static ssize_t naive_latency_show(struct naive_sb_info *sbi,
+                                  struct naive_attr *a, char *buf)
+{
+    u64 hist[NAIVE_LAT_BUCKETS] = { 0 };
+    int cpu, i, len = 0;
+    
+    for_each_possible_cpu(cpu) {
+        struct naive_stats *st = per_cpu_ptr(sbi->stats, cpu);
+        for (i = 0; i < NAIVE_LAT_BUCKETS; i++)
+            hist[i] += st->lat[a->item][i];
+    }
+    
+    for (i = 0; i < NAIVE_LAT_BUCKETS; i++) {
+        unsigned long lo = i ? 1UL << (i - 1) : 0;
+        
+        if (i == NAIVE_LAT_BUCKETS - 1)
+            len += sysfs_emit_at(buf, len, "%lu+us %llu\n", lo, hist[i]);
+        else
+            len += sysfs_emit_at(buf, len, "%lu-%luus %llu\n",
+                                 lo, 1UL << i, hist[i]);
+    }
+    return len;
+}
+
+#define NAIVE_COUNTER_ATTR(_name, _item)                            \
+static struct naive_attr naive_attr_##_name = {                     \
+    .attr = { .name = __stringify(_name), .mode = 0444 },           \
+    .item = _item,                                                  \
+    .show = naive_counter_show,                                     \
+}
+
+#define NAIVE_LATENCY_ATTR(_name, _item)                            \
+static struct naive_attr naive_attr_##_name = {                     \
+    .attr = { .name = __stringify(_name), .mode = 0444 },           \
+    .item = _item,                                                  \
+    .show = naive_latency_show,                                     \
+}
+
+NAIVE_COUNTER_ATTR(blocks_allocated,    NAIVE_STAT_BLOCKS_ALLOCATED);
+NAIVE_COUNTER_ATTR(blocks_freed,        NAIVE_STAT_BLOCKS_FREED);
+NAIVE_COUNTER_ATTR(blocks_discarded,    NAIVE_STAT_BLOCKS_DISCARDED);
+NAIVE_COUNTER_ATTR(alloc_scans,         NAIVE_STAT_ALLOC_SCANS);
+NAIVE_COUNTER_ATTR(alloc_scanned_bits,  NAIVE_STAT_ALLOC_SCANNED_BITS);
+NAIVE_COUNTER_ATTR(lookup_hits,         NAIVE_STAT_LOOKUP_HITS);
+NAIVE_COUNTER_ATTR(lookup_misses,       NAIVE_STAT_LOOKUP_MISSES);
+NAIVE_COUNTER_ATTR(lookup_dir_blocks,   NAIVE_STAT_LOOKUP_DIR_BLOCKS);
+NAIVE_COUNTER_ATTR(inode_reads,         NAIVE_STAT_INODE_READS);
+NAIVE_COUNTER_ATTR(inode_writes,        NAIVE_STAT_INODE_WRITES);
+NAIVE_COUNTER_ATTR(bytes_read,          NAIVE_STAT_BYTES_READ);
+NAIVE_COUNTER_ATTR(bytes_written,       NAIVE_STAT_BYTES_WRITTEN);
+NAIVE_COUNTER_ATTR(ra_sequential,       NAIVE_STAT_RA_SEQUENTIAL);
+NAIVE_COUNTER_ATTR(ra_random,           NAIVE_STAT_RA_RANDOM);
+NAIVE_LATENCY_ATTR(read_latency,        NAIVE_LAT_READ);
+NAIVE_LATENCY_ATTR(write_latency,       NAIVE_LAT_WRITE);
+NAIVE_LATENCY_ATTR(lookup_latency,      NAIVE_LAT_LOOKUP);
+
+static struct attribute *naive_sb_attrs[] = {
+    &naive_attr_blocks_allocated.attr,
+    &naive_attr_blocks_freed.attr,
+    &naive_attr_blocks_discarded.attr,
+    &naive_attr_alloc_scans.attr,
+    &naive_attr_alloc_scanned_bits.attr,
+    &naive_attr_lookup_hits.attr,
+    &naive_attr_lookup_misses.attr,
+    &naive_attr_lookup_dir_blocks.attr,
+    &naive_attr_inode_reads.attr,
+    &naive_attr_inode_writes.attr,
+    &naive_attr_bytes_read.attr,
+    &naive_attr_bytes_written.attr,
+    &naive_attr_ra_sequential.attr,
+    &naive_attr_ra_random.attr,
+    &naive_attr_read_latency.attr,
+    &naive_attr_write_latency.attr,
+    &naive_attr_lookup_latency.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(naive_sb);
+
+static ssize_t naive_attr_show(struct kobject *kobj,
+                               struct attribute *attr, char *buf)
+{
+    struct naive_sb_info *sbi = container_of(kobj, struct naive_sb_info, s_kobj);
+    struct naive_attr *a = container_of(attr, struct naive_attr, attr);
+    
+    return a->show(sbi, a, buf);
+}
+
+static const struct sysfs_ops naive_attr_ops = {
+    .show   = naive_attr_show,
+};
+
+static void naive_sb_release(struct kobject *kobj)
+{
+    struct naive_sb_info *sbi = container_of(kobj, struct naive_sb_info, s_kobj);
+    
+    complete(&sbi->s_kobj_unregister);
+}
+
+static const struct kobj_type naive_sb_ktype = {
+    .default_groups = naive_sb_groups,
+    .sysfs_ops      = &naive_attr_ops,
+    .release        = naive_sb_release,
+};
+
+/* 创建/sys/fs/naive/<dev>/ */
+int naive_register_sysfs(struct super_block *sb)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    int ret;
+    
+    init_completion(&sbi->s_kobj_unregister);
+    sbi->s_kobj.kset = naive_kset;
+    ret = kobject_init_and_add(&sbi->s_kobj, &naive_sb_ktype, NULL,
+                               "%s", sb->s_id);
+    if (ret) {
+        kobject_put(&sbi->s_kobj);
+        wait_for_completion(&sbi->s_kobj_unregister);
+    }
+    return ret;
+}
+
+void naive_unregister_sysfs(struct super_block *sb)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    
+    kobject_del(&sbi->s_kobj);
+    kobject_put(&sbi->s_kobj);
+    wait_for_completion(&sbi->s_kobj_unregister);
+}
+
+int naive_sysfs_init(void)
+{
+    naive_kset = kset_create_and_add("naive", NULL, fs_kobj);
+    if (!naive_kset)
+        return -ENOMEM;
+    return 0;
+}
+
+void naive_sysfs_exit(void)
+{
+    kset_unregister(naive_kset);
+}
@@ -0,0 +1,549 @@
+#include "naivefs.h"
+
+#include <linux/xattr.h>
+#include <linux/mbcache.h>
+#include <linux/jhash.h>
+#include <linux/security.h>
+
+/*
+ * 扩展属性：放得下的条目存放在inode内的i_xattr区，随inode一起读入，读取
+ * 不需要额外的I/O；放不下的条目存放在扩展属性块中。扩展属性块按内容共享：
+ * 条目完全相同的inode引用同一个块，块头记录引用计数，修改共享的块时另写
+ * 一个新块。内存中的mbcache按条目的哈希索引已知的扩展属性块。
+ *
+ * inode的xattr_sem保护i_xattr和i_xattr_block；sbi->xattr_lock串行化扩展
+ * 属性块的查找、共享和引用计数的修改。
+ */
+
+#define NAIVE_XATTR_HDR(bh) ((struct naive_xattr_header *)(bh)->b_data)
+#define NAIVE_XATTR_FIRST(bh) ((bh)->b_data + sizeof(struct naive_xattr_header))
+#define NAIVE_XATTR_BLOCK_AREA (NAIVE_BLOCK_SIZE - sizeof(struct naive_xattr_header))
+/* 修改时收集一个inode全部条目的工作区 */
+#define NAIVE_XATTR_BUF_SIZE (NAIVE_INODE_XATTR_SIZE + NAIVE_XATTR_BLOCK_AREA)
+#define NAIVE_XATTR_CACHE_BITS 6
+
+static struct naive_xattr_entry *naive_xattr_next(struct naive_xattr_entry *e)
+{
+    return (void *)e + NAIVE_XATTR_ENTRY_SIZE(e->e_name_len,
+                                              le16_to_cpu(e->e_value_size));
+}
+
+/* 遍历[start, end)中的条目，越界的条目视为结束 */
+#define naive_xattr_for_each(e, start, end)                             \
+    for (e = (struct naive_xattr_entry *)(start);                      \
+         (void *)(e + 1) <= (void *)(end) && e->e_name_len &&           \
+         (void *)naive_xattr_next(e) <= (void *)(end);                  \
+         e = naive_xattr_next(e))
+
+static struct naive_xattr_entry *naive_xattr_find(void *start, void *end, int index,
+                                                  const char *name, size_t name_len)
+{
+    struct naive_xattr_entry *e;
+    
+    naive_xattr_for_each(e, start, end) {
+        if (e->e_name_index == index && e->e_name_len == name_len &&
+            memcmp(e->e_name, name, name_len) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+/* 读扩展属性块并检查块头 */
+static struct buffer_head *naive_xattr_bread(struct inode *inode, u32 bno)
+{
+    struct buffer_head *bh = sb_bread(inode->i_sb, bno);
+    
+    if (!bh)
+        return ERR_PTR(-EIO);
+    if (NAIVE_XATTR_HDR(bh)->h_magic != cpu_to_le32(NAIVE_XATTR_MAGIC)) {
+        printk(KERN_ERR "naivefs: inode %lu: bad xattr block %u\n",
+               inode->i_ino, bno);
+        brelse(bh);
+        return ERR_PTR(-EIO);
+    }
+    return bh;
+}
+
+static void naive_xattr_cache_insert(struct naive_sb_info *sbi, u32 hash, u32 bno)
+{
+    /* 已在缓存中时返回-EBUSY，忽略 */
+    mb_cache_entry_create(sbi->xattr_cache, GFP_NOFS, hash, bno, true);
+}
+
+static void naive_xattr_cache_remove(struct naive_sb_info *sbi, u32 hash, u32 bno)
+{
+    struct mb_cache_entry *ce;
+    
+    /* 查找都在xattr_lock下进行，条目不会正被使用 */
+    ce = mb_cache_entry_delete_or_get(sbi->xattr_cache, hash, bno);
+    if (ce)
+        mb_cache_entry_put(sbi->xattr_cache, ce);
+}
+
+static int naive_xattr_get(struct inode *inode, int index, const char *name,
+                           void *buffer, size_t size)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    size_t name_len = strlen(name);
+    struct naive_xattr_entry *e;
+    struct buffer_head *bh = NULL;
+    int ret;
+    
+    if (!naive_has_feature(sbi, NAIVE_FEATURE_XATTR))
+        return -EOPNOTSUPP;
+    if (name_len > 255)
+        return -ERANGE;
+    
+    down_read(&nii->xattr_sem);
+    e = naive_xattr_find(nii->i_xattr, nii->i_xattr + NAIVE_INODE_XATTR_SIZE,
+                         index, name, name_len);
+    if (!e && nii->i_xattr_block) {
+        bh = naive_xattr_bread(inode, nii->i_xattr_block);
+        if (IS_ERR(bh)) {
+            ret = PTR_ERR(bh);
+            goto out;
+        }
+        /* 挂载前就存在的块在第一次读到时加入缓存，之后可被共享 */
+        naive_xattr_cache_insert(sbi, le32_to_cpu(NAIVE_XATTR_HDR(bh)->h_hash),
+                                 nii->i_xattr_block);
+        e = naive_xattr_find(NAIVE_XATTR_FIRST(bh), bh->b_data + NAIVE_BLOCK_SIZE,
+                             index, name, name_len);
+    }
+    
+    ret = -ENODATA;
+    if (e) {
+        ret = le16_to_cpu(e->e_value_size);
+        if (buffer) {
+            if (ret > size)
+                ret = -ERANGE;
+            else
+                memcpy(buffer, e->e_name + e->e_name_len, ret);
+        }
+    }
+    brelse(bh);
+out:
+    up_read(&nii->xattr_sem);
+    return ret;
+}
+
+static const char *naive_xattr_prefix(int index)
+{
+    switch (index) {
+    case NAIVE_XATTR_INDEX_USER:
+        return XATTR_USER_PREFIX;
+    case NAIVE_XATTR_INDEX_TRUSTED:
+        return capable(CAP_SYS_ADMIN) ? XATTR_TRUSTED_PREFIX : NULL;
+    case NAIVE_XATTR_INDEX_SECURITY:
+        return XATTR_SECURITY_PREFIX;
+    }
+    return NULL;
+}
+
+/* 把[start, end)中条目的完整名字追加到buffer，返回新的总长度 */
+static ssize_t naive_xattr_list_entries(void *start, void *end, char *buffer,
+                                        size_t size, ssize_t used)
+{
+    struct naive_xattr_entry *e;
+    
+    naive_xattr_for_each(e, start, end) {
+        const char *prefix = naive_xattr_prefix(e->e_name_index);
+        size_t prefix_len, len;
+        
+        if (!prefix)
+            continue;
+        prefix_len = strlen(prefix);
+        len = prefix_len + e->e_name_len + 1;
+        if (buffer) {
+            if (used + len > size)
+                return -ERANGE;
+            memcpy(buffer + used, prefix, prefix_len);
+            memcpy(buffer + used + prefix_len, e->e_name, e->e_name_len);
+            buffer[used + len - 1] = '\0';
+        }
+        used += len;
+    }
+    return used;
+}
+
+ssize_t naive_listxattr(struct dentry *dentry, char *buffer, size_t size)
+{
+    struct inode *inode = d_inode(dentry);
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    struct buffer_head *bh;
+    ssize_t ret;
+    
+    if (!naive_has_feature(NAIVE_SB(inode->i_sb), NAIVE_FEATURE_XATTR))
+        return 0;
+    
+    down_read(&nii->xattr_sem);
+    ret = naive_xattr_list_entries(nii->i_xattr,
+                                   nii->i_xattr + NAIVE_INODE_XATTR_SIZE,
+                                   buffer, size, 0);
+    if (ret >= 0 && nii->i_xattr_block) {
+        bh = naive_xattr_bread(inode, nii->i_xattr_block);
+        if (IS_ERR(bh)) {
+            ret = PTR_ERR(bh);
+        } else {
+            ret = naive_xattr_list_entries(NAIVE_XATTR_FIRST(bh),
+                                           bh->b_data + NAIVE_BLOCK_SIZE,
+                                           buffer, size, ret);
+            brelse(bh);
+        }
+    }
+    up_read(&nii->xattr_sem);
+    return ret;
+}
+
+/* 把[start, end)中的条目依次复制到buf + used，返回新的used */
+static size_t naive_xattr_collect(void *start, void *end, char *buf, size_t used)
+{
+    struct naive_xattr_entry *e;
+    size_t size;
+    
+    naive_xattr_for_each(e, start, end) {
+        size = (void *)naive_xattr_next(e) - (void *)e;
+        memcpy(buf + used, e, size);
+        used += size;
+    }
+    return used;
+}
+
+/*
+ * 为条目为blk（NAIVE_XATTR_BLOCK_AREA字节，未用部分为0）的扩展属性块找一个
+ * 块：已有内容相同的块时共享它；原来的块old只有本inode引用时就地改写；
+ * 否则分配新块。返回的块已计入本inode的引用。调用者持有xattr_lock。
+ */
+static int naive_xattr_get_block(struct inode *inode, const void *blk, size_t len,
+                                 u32 old, u32 *bno)
+{
+    struct super_block *sb = inode->i_sb;
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    struct mb_cache_entry *ce;
+    struct buffer_head *bh;
+    u32 hash = jhash(blk, len, 0);
+    u32 new;
+    int ret;
+    
+    /* 查找内容相同的块 */
+    ce = mb_cache_entry_find_first(sbi->xattr_cache, hash);
+    while (ce) {
+        bh = naive_xattr_bread(inode, ce->e_value);
+        if (!IS_ERR(bh)) {
+            if (memcmp(NAIVE_XATTR_FIRST(bh), blk, NAIVE_XATTR_BLOCK_AREA) == 0) {
+                if (ce->e_value != old) {
+                    lock_buffer(bh);
+                    le32_add_cpu(&NAIVE_XATTR_HDR(bh)->h_refcount, 1);
+                    unlock_buffer(bh);
+                    mark_buffer_dirty(bh);
+                }
+                *bno = ce->e_value;
+                brelse(bh);
+                mb_cache_entry_put(sbi->xattr_cache, ce);
+                return 0;
+            }
+            brelse(bh);
+        }
+        ce = mb_cache_entry_find_next(sbi->xattr_cache, ce);
+    }
+    
+    /* 原来的块只有本inode引用：就地改写 */
+    if (old) {
+        bh = naive_xattr_bread(inode, old);
+        if (IS_ERR(bh))
+            return PTR_ERR(bh);
+        if (le32_to_cpu(NAIVE_XATTR_HDR(bh)->h_refcount) == 1) {
+            naive_xattr_cache_remove(sbi, le32_to_cpu(NAIVE_XATTR_HDR(bh)->h_hash), old);
+            lock_buffer(bh);
+            memcpy(NAIVE_XATTR_FIRST(bh), blk, NAIVE_XATTR_BLOCK_AREA);
+            NAIVE_XATTR_HDR(bh)->h_hash = cpu_to_le32(hash);
+            unlock_buffer(bh);
+            mark_buffer_dirty(bh);
+            brelse(bh);
+            naive_xattr_cache_insert(sbi, hash, old);
+            *bno = old;
+            return 0;
+        }
+        brelse(bh);
+    }
+    
+    ret = naive_alloc_blocks(sbi, 0, 1, &new);
+    if (ret < 0)
+        return ret;
+    
+    bh = sb_getblk(sb, new);
+    if (!bh) {
+        naive_free_block(sbi, new);
+        return -ENOMEM;
+    }
+    lock_buffer(bh);
+    memset(bh->b_data, 0, NAIVE_BLOCK_SIZE);
+    NAIVE_XATTR_HDR(bh)->h_magic = cpu_to_le32(NAIVE_XATTR_MAGIC);
+    NAIVE_XATTR_HDR(bh)->h_refcount = cpu_to_le32(1);
+    NAIVE_XATTR_HDR(bh)->h_hash = cpu_to_le32(hash);
+    memcpy(NAIVE_XATTR_FIRST(bh), blk, NAIVE_XATTR_BLOCK_AREA);
+    set_buffer_uptodate(bh);
+    unlock_buffer(bh);
+    mark_buffer_dirty(bh);
+    brelse(bh);
+    
+    naive_xattr_cache_insert(sbi, hash, new);
+    *bno = new;
+    return 0;
+}
+
+/* 本inode不再引用扩展属性块bno，引用计数减到0时释放块。调用者持有xattr_lock */
+static void naive_xattr_put_block(struct inode *inode, u32 bno)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    struct buffer_head *bh;
+    
+    bh = naive_xattr_bread(inode, bno);
+    if (IS_ERR(bh))
+        return;
+    
+    inode_sub_bytes(inode, NAIVE_BLOCK_SIZE);
+    if (le32_to_cpu(NAIVE_XATTR_HDR(bh)->h_refcount) <= 1) {
+        naive_xattr_cache_remove(sbi, le32_to_cpu(NAIVE_XATTR_HDR(bh)->h_hash), bno);
+        /* 丢弃缓冲区，避免回写到已被复用的块 */
+        bforget(bh);
+        naive_free_block(sbi, bno);
+        return;
+    }
+    
+    lock_buffer(bh);
+    le32_add_cpu(&NAIVE_XATTR_HDR(bh)->h_refcount, -1);
+    unlock_buffer(bh);
+    mark_buffer_dirty(bh);
+    brelse(bh);
+}
+
+/*
+ * 设置扩展属性，value为NULL时删除。把inode内和块中的条目收集到工作区中
+ * 修改，再重新分配：每个条目放得进inode内的区域就放在inode内，否则放进
+ * 扩展属性块。
+ */
+static int naive_xattr_set(struct inode *inode, int index, const char *name,
+                           const void *value, size_t value_len, int flags)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    size_t name_len = strlen(name);
+    struct naive_xattr_entry *e;
+    struct buffer_head *bh;
+    char *buf, *in, *blk;
+    size_t used = 0, in_used = 0, blk_used = 0, size;
+    u32 old, new = 0;
+    int ret = 0;
+    
+    if (!naive_has_feature(sbi, NAIVE_FEATURE_XATTR))
+        return -EOPNOTSUPP;
+    if (name_len == 0)
+        return -EINVAL;
+    if (name_len > 255)
+        return -ERANGE;
+    if (value && NAIVE_XATTR_ENTRY_SIZE(name_len, value_len) > NAIVE_XATTR_BLOCK_AREA)
+        return -ENOSPC;
+    
+    buf = kzalloc(NAIVE_XATTR_BUF_SIZE * 2, GFP_NOFS);
+    if (!buf)
+        return -ENOMEM;
+    in = buf + NAIVE_XATTR_BUF_SIZE;
+    blk = in + NAIVE_INODE_XATTR_SIZE;
+    
+    down_write(&nii->xattr_sem);
+    old = nii->i_xattr_block;
+    used = naive_xattr_collect(nii->i_xattr, nii->i_xattr + NAIVE_INODE_XATTR_SIZE,
+                               buf, used);
+    if (old) {
+        bh = naive_xattr_bread(inode, old);
+        if (IS_ERR(bh)) {
+            ret = PTR_ERR(bh);
+            goto out;
+        }
+        naive_xattr_cache_insert(sbi, le32_to_cpu(NAIVE_XATTR_HDR(bh)->h_hash), old);
+        used = naive_xattr_collect(NAIVE_XATTR_FIRST(bh),
+                                   bh->b_data + NAIVE_BLOCK_SIZE, buf, used);
+        brelse(bh);
+    }
+    
+    e = naive_xattr_find(buf, buf + used, index, name, name_len);
+    if (e && (flags & XATTR_CREATE)) {
+        ret = -EEXIST;
+        goto out;
+    }
+    if (!e && (flags & XATTR_REPLACE)) {
+        ret = -ENODATA;
+        goto out;
+    }
+    if (!e && !value)
+        goto out;
+    
+    if (e) {
+        size = (void *)naive_xattr_next(e) - (void *)e;
+        memmove(e, (void *)e + size, buf + used - ((char *)e + size));
+        used -= size;
+        memset(buf + used, 0, size);
+    }
+    if (value) {
+        size = NAIVE_XATTR_ENTRY_SIZE(name_len, value_len);
+        if (used + size > NAIVE_XATTR_BUF_SIZE) {
+            ret = -ENOSPC;
+            goto out;
+        }
+        e = (struct naive_xattr_entry *)(buf + used);
+        e->e_name_index = index;
+        e->e_name_len = name_len;
+        e->e_value_size = cpu_to_le16(value_len);
+        memcpy(e->e_name, name, name_len);
+        memcpy(e->e_name + name_len, value, value_len);
+        used += size;
+    }
+    
+    naive_xattr_for_each(e, buf, buf + used) {
+        size = (void *)naive_xattr_next(e) - (void *)e;
+        if (in_used + size <= NAIVE_INODE_XATTR_SIZE) {
+            memcpy(in + in_used, e, size);
+            in_used += size;
+        } else if (blk_used + size <= NAIVE_XATTR_BLOCK_AREA) {
+            memcpy(blk + blk_used, e, size);
+            blk_used += size;
+        } else {
+            ret = -ENOSPC;
+            goto out;
+        }
+    }
+    
+    if (blk_used) {
+        mutex_lock(&sbi->xattr_lock);
+        ret = naive_xattr_get_block(inode, blk, blk_used, old, &new);
+        mutex_unlock(&sbi->xattr_lock);
+        if (ret)
+            goto out;
+    }
+    
+    memcpy(nii->i_xattr, in, NAIVE_INODE_XATTR_SIZE);
+    nii->i_xattr_block = new;
+    if (new != old) {
+        if (new)
+            inode_add_bytes(inode, NAIVE_BLOCK_SIZE);
+        if (old) {
+            mutex_lock(&sbi->xattr_lock);
+            naive_xattr_put_block(inode, old);
+            mutex_unlock(&sbi->xattr_lock);
+        }
+    }
+    inode_set_ctime_current(inode);
+    mark_inode_dirty(inode);
+    
+out:
+    up_write(&nii->xattr_sem);
+    kfree(buf);
+    return ret;
+}
+
+/* inode被删除：释放它对扩展属性块的引用 */
+void naive_xattr_delete_inode(struct inode *inode)
+{
+    struct naive_inode_info *nii = NAIVE_I(inode);
+    struct naive_sb_info *sbi = NAIVE_SB(inode->i_sb);
+    
+    if (!nii->i_xattr_block)
+        return;
+    
+    mutex_lock(&sbi->xattr_lock);
+    naive_xattr_put_block(inode, nii->i_xattr_block);
+    mutex_unlock(&sbi->xattr_lock);
+    nii->i_xattr_block = 0;
+}
+
+static int naive_xattr_handler_get(const struct xattr_handler *handler,
+                                   struct dentry *unused, struct inode *inode,
+                                   const char *name, void *buffer, size_t size)
+{
+    return naive_xattr_get(inode, handler->flags, name, buffer, size);
+}
+
+static int naive_xattr_handler_set(const struct xattr_handler *handler,
+                                   struct mnt_idmap *idmap,
+                                   struct dentry *unused, struct inode *inode,
+                                   const char *name, const void *value,
+                                   size_t size, int flags)
+{
+    return naive_xattr_set(inode, handler->flags, name, value, size, flags);
+}
+
+static const struct xattr_handler naive_xattr_user_handler = {
+    .prefix = XATTR_USER_PREFIX,
+    .flags  = NAIVE_XATTR_INDEX_USER,
+    .get    = naive_xattr_handler_get,
+    .set    = naive_xattr_handler_set,
+};
+
+static const struct xattr_handler naive_xattr_trusted_handler = {
+    .prefix = XATTR_TRUSTED_PREFIX,
+    .flags  = NAIVE_XATTR_INDEX_TRUSTED,
+    .get    = naive_xattr_handler_get,
+    .set    = naive_xattr_handler_set,
+};
+
+static const struct xattr_handler naive_xattr_security_handler = {
+    .prefix = XATTR_SECURITY_PREFIX,
+    .flags  = NAIVE_XATTR_INDEX_SECURITY,
+    .get    = naive_xattr_handler_get,
+    .set    = naive_xattr_handler_set,
+};
+
+const struct xattr_handler * const naive_xattr_handlers[] = {
+    &naive_xattr_user_handler,
+    &naive_xattr_trusted_handler,
+    &naive_xattr_security_handler,
+    NULL,
+};
+
+static int naive_initxattrs(struct inode *inode, const struct xattr *xattr_array,
+                            void *fs_info)
+{
+    const struct xattr *xattr;
+    int ret = 0;
+    
+    for (xattr = xattr_array; xattr->name; xattr++) {
+        ret = naive_xattr_set(inode, NAIVE_XATTR_INDEX_SECURITY, xattr->name,
+                              xattr->value, xattr->value_len, 0);
+        if (ret)
+            break;
+    }
+    return ret;
+}
+
+/* 新inode的安全标签（如SELinux），通常放得进inode内的区域 */
+int naive_init_security(struct inode *inode, struct inode *dir,
+                        const struct qstr *qstr)
+{
+    if (!naive_has_feature(NAIVE_SB(inode->i_sb), NAIVE_FEATURE_XATTR))
+        return 0;
+    return security_inode_init_security(inode, dir, qstr, &naive_initxattrs, NULL);
+}
+
+int naive_xattr_init(struct super_block *sb)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    
+    mutex_init(&sbi->xattr_lock);
+    sb->s_xattr = naive_xattr_handlers;
+    if (!naive_has_feature(sbi, NAIVE_FEATURE_XATTR))
+        return 0;
+    
+    sbi->xattr_cache = mb_cache_create(NAIVE_XATTR_CACHE_BITS);
+    return sbi->xattr_cache ? 0 : -ENOMEM;
+}
+
+void naive_xattr_exit(struct super_block *sb)
+{
+    struct naive_sb_info *sbi = NAIVE_SB(sb);
+    
+    if (sbi->xattr_cache) {
+        mb_cache_destroy(sbi->xattr_cache);
+        sbi->xattr_cache = NULL;
+    }
+}
@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/types.h>
+
+/* 与内核naivefs.h一致 */
+#define NAIVE_IOC_RESIZE _IOW('N', 2, __u64)
+#define NAIVE_BLOCK_SIZE 512
+
+/* 解析大小：纯数字为块数，带K/M/G后缀为字节数 */
+static int parse_size(const char *arg, __u64 *blocks)
+{
+    char *end;
+    unsigned long long n = strtoull(arg, &end, 0);
+    
+    switch (*end) {
+    case 'G': case 'g':
+        n <<= 10;
+        /* fall through */
+    case 'M': case 'm':
+        n <<= 10;
+        /* fall through */
+    case 'K': case 'k':
+        n <<= 10;
+        n /= NAIVE_BLOCK_SIZE;
+        end++;
+        break;
+    }
+    if (*end || end == arg)
+        return -1;
+    *blocks = n;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    __u64 blocks = 0;   /* 0表示扩到整个设备 */
+    int fd;
+    
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s <mountpoint> [blocks|size{K,M,G}]\n", argv[0]);
+        exit(1);
+    }
+    if (argc == 3 && parse_size(argv[2], &blocks) < 0) {
+        fprintf(stderr, "invalid size: %s\n", argv[2]);
+        exit(1);
+    }
+    
+    fd = open(argv[1], O_RDONLY);
+    if (fd < 0) {
+        perror("open mountpoint failed");
+        exit(1);
+    }
+    
+    if (ioctl(fd, NAIVE_IOC_RESIZE, &blocks) < 0) {
+        fprintf(stderr, "resize failed: %s\n", strerror(errno));
+        close(fd);
+        exit(1);
+    }
+    close(fd);
+    
+    if (blocks)
+        printf("Resized to %llu blocks\n", (unsigned long long)blocks);
+    else
+        printf("Resized to fill the device\n");
+    return 0;
+}
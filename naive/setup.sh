@@ -36,7 +36,7 @@ fi
 
 # 5. 格式化磁盘
 echo -e "\n5. 格式化磁盘..."
-if [ ! -f mkfs.naive ]; then
+if [ ! -f mkfs.naive ] || [ mkfs.naive.c -nt mkfs.naive ]; then
     echo "编译mkfs.naive..."
     gcc -o mkfs.naive mkfs.naive.c
 fi
@@ -0,0 +1,55 @@
+#!/bin/bash
+
+echo "=== splice/copy_file_range测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+
+dd if=/dev/urandom of=/mnt/naive/src.bin bs=512 count=6 2>/dev/null
+head -c 100 /dev/urandom >> /mnt/naive/src.bin
+
+# 1. copy_file_range：整块在文件系统内按块复制，尾部经页缓存复制
+echo -e "\n1. copy_file_range..."
+cp --reflink=never /mnt/naive/src.bin /mnt/naive/dst.bin
+sync
+echo 3 | sudo tee /proc/sys/vm/drop_caches > /dev/null
+if cmp -s /mnt/naive/src.bin /mnt/naive/dst.bin; then
+    echo "✅ 复制结果一致"
+else
+    echo "❌ 复制结果不一致"
+fi
+
+# 2. 未对齐偏移
+echo -e "\n2. 未对齐的copy_file_range..."
+python3 -c '
+import os
+i = os.open("/mnt/naive/src.bin", os.O_RDONLY)
+o = os.open("/mnt/naive/off.bin", os.O_RDWR | os.O_CREAT | os.O_TRUNC)
+os.copy_file_range(i, o, 1000, 10, 0)
+'
+if cmp -s <(tail -c +11 /mnt/naive/src.bin | head -c 1000) /mnt/naive/off.bin; then
+    echo "✅ 未对齐复制一致"
+else
+    echo "❌ 未对齐复制不一致"
+fi
+
+# 3. sendfile走splice_read
+echo -e "\n3. sendfile..."
+python3 -c '
+import os
+i = os.open("/mnt/naive/src.bin", os.O_RDONLY)
+o = os.open("/tmp/naive_sendfile.bin", os.O_WRONLY | os.O_CREAT | os.O_TRUNC)
+n = os.fstat(i).st_size
+while n > 0:
+    n -= os.sendfile(o, i, None, n)
+'
+if cmp -s /mnt/naive/src.bin /tmp/naive_sendfile.bin; then
+    echo "✅ sendfile结果一致"
+else
+    echo "❌ sendfile结果不一致"
+fi
+
+rm -f /mnt/naive/src.bin /mnt/naive/dst.bin /mnt/naive/off.bin /tmp/naive_sendfile.bin
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
@@ -0,0 +1,74 @@
+#!/bin/bash
+
+echo "=== 在线整理测试 ==="
+
+cd ~/filesystem_lab/naive
+gcc -O2 -o defrag.naive defrag.naive.c || exit 1
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+
+A=/mnt/naive/a
+B=/mnt/naive/b
+
+# 1. 两个文件交替追加，块相互穿插
+echo -e "\n1. 制造碎片..."
+rm -f $A $B
+for i in $(seq 1 40); do
+    head -c 1024 /dev/urandom >> $A
+    sync
+    head -c 1024 /dev/urandom >> $B
+    sync
+done
+rm $B
+sync
+BEFORE=$(filefrag $A | awk '{print $2}')
+MD5=$(md5sum < $A)
+if [ "$BEFORE" -gt 1 ]; then
+    echo "✅ a有 $BEFORE 个段"
+else
+    echo "❌ 没有产生碎片（$BEFORE 个段）"
+fi
+
+# 2. 整理期间文件可读
+echo -e "\n2. 整理..."
+( for i in $(seq 1 50); do cat $A > /dev/null; done ) &
+READER=$!
+sudo ./defrag.naive -v $A
+wait $READER && echo "✅ 整理期间读取正常" || echo "❌ 整理期间读取失败"
+
+AFTER=$(filefrag $A | awk '{print $2}')
+if [ "$AFTER" -lt "$BEFORE" ]; then
+    echo "✅ 段数 $BEFORE -> $AFTER"
+else
+    echo "❌ 段数没有减少（$BEFORE -> $AFTER）"
+fi
+
+# 3. 内容不变，重新挂载后仍然正确
+echo -e "\n3. 数据校验..."
+sudo umount /mnt/naive
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+if [ "$(md5sum < $A)" = "$MD5" ]; then
+    echo "✅ 内容一致"
+else
+    echo "❌ 内容改变"
+fi
+
+# 4. 已经连续的文件不搬移
+echo -e "\n4. 再次整理..."
+if sudo ./defrag.naive $A | grep -q "Total: 0 blocks moved"; then
+    echo "✅ 连续的文件没有搬移"
+else
+    echo "❌ 重复搬移了连续的文件"
+fi
+
+# 5. 按目录整理
+echo -e "\n5. 按目录整理..."
+if sudo ./defrag.naive /mnt/naive > /dev/null; then
+    echo "✅ 目录整理完成"
+else
+    echo "❌ 目录整理失败"
+fi
+
+rm -f $A
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
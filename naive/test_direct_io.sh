@@ -0,0 +1,37 @@
+#!/bin/bash
+
+echo "=== O_DIRECT测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+
+# 1. 对齐的直接写和直接读
+echo -e "\n1. 对齐的直接I/O..."
+dd if=/dev/urandom of=/tmp/naive_dio.src bs=512 count=4 2>/dev/null
+dd if=/tmp/naive_dio.src of=/mnt/naive/dio.bin bs=512 count=4 oflag=direct 2>/dev/null
+dd if=/mnt/naive/dio.bin of=/tmp/naive_dio.dst bs=512 count=4 iflag=direct 2>/dev/null
+if cmp -s /tmp/naive_dio.src /tmp/naive_dio.dst; then
+    echo "✅ 直接写入的数据读回一致"
+else
+    echo "❌ 数据不一致"
+fi
+
+# 2. 缓冲读应看到直接写的内容
+if cmp -s /tmp/naive_dio.src /mnt/naive/dio.bin; then
+    echo "✅ 缓冲读与直接写一致"
+else
+    echo "❌ 缓冲读看到旧数据"
+fi
+
+# 3. 未对齐的直接I/O应返回EINVAL
+echo -e "\n2. 未对齐的直接I/O..."
+if dd if=/tmp/naive_dio.src of=/mnt/naive/dio.bin bs=100 count=1 oflag=direct 2>/dev/null; then
+    echo "❌ 未对齐写入被接受"
+else
+    echo "✅ 未对齐写入被拒绝"
+fi
+
+rm -f /mnt/naive/dio.bin /tmp/naive_dio.src /tmp/naive_dio.dst
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
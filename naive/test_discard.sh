@@ -0,0 +1,67 @@
+#!/bin/bash
+
+echo "=== 丢弃（discard/FITRIM）测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop,discard,commit=1 tmpfile /mnt/naive || exit 1
+
+F=/mnt/naive/big
+DEV=$(basename $(findmnt -n -o SOURCE /mnt/naive))
+S=/sys/fs/naive/$DEV
+
+# 1. 选项显示在/proc/mounts中（loop设备支持丢弃）
+echo -e "\n1. 挂载选项..."
+if grep -q "/mnt/naive .*discard" /proc/mounts; then
+    echo "✅ discard已启用"
+else
+    echo "❌ /proc/mounts中没有discard，设备可能不支持丢弃"
+fi
+
+# 2. 删除文件后，位图提交时丢弃释放的块
+echo -e "\n2. 删除后自动丢弃..."
+dd if=/dev/urandom of=$F bs=4k count=20 2>/dev/null
+sync
+USED=$(du -k tmpfile | cut -f1)
+DISCARDED=$(cat $S/blocks_discarded)
+rm $F
+sleep 2
+N=$(( $(cat $S/blocks_discarded) - DISCARDED ))
+if [ $N -ge 160 ]; then
+    echo "✅ 丢弃了 $N 个块，tmpfile占用 ${USED}KB -> $(du -k tmpfile | cut -f1)KB"
+else
+    echo "❌ 只丢弃了 $N 个块"
+fi
+
+# 3. 丢弃后块可以重新分配，数据正确
+echo -e "\n3. 丢弃后重新写入..."
+dd if=/dev/urandom of=/tmp/naive_discard bs=4k count=20 2>/dev/null
+cp /tmp/naive_discard $F
+sync
+echo 3 | sudo tee /proc/sys/vm/drop_caches > /dev/null
+if cmp -s /tmp/naive_discard $F; then
+    echo "✅ 数据正确"
+else
+    echo "❌ 数据不一致"
+fi
+rm -f $F /tmp/naive_discard
+
+# 4. 不带discard时由fstrim批量丢弃空闲区
+echo -e "\n4. fstrim..."
+sudo mount -o remount,nodiscard /mnt/naive
+if sudo fstrim -v /mnt/naive; then
+    echo "✅ fstrim成功"
+else
+    echo "❌ fstrim失败"
+fi
+
+# 5. 最小长度大于整个文件系统时拒绝
+echo -e "\n5. fstrim参数检查..."
+if sudo fstrim -m 1G /mnt/naive 2>/dev/null; then
+    echo "❌ 过大的minimum被接受"
+else
+    echo "✅ 过大的minimum被拒绝"
+fi
+
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
@@ -0,0 +1,68 @@
+#!/bin/bash
+
+echo "=== fallocate测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+
+F=/mnt/naive/falloc.bin
+
+# 1. 预分配：文件大小变化，内容为0，块为未写入状态
+echo -e "\n1. 预分配..."
+rm -f $F
+fallocate -l 4096 $F
+if [ "$(stat -c %s $F)" -eq 4096 ] && cmp -s $F <(head -c 4096 /dev/zero); then
+    echo "✅ 预分配后大小为4096且读出为0"
+else
+    echo "❌ 预分配结果错误"
+fi
+if filefrag -v $F 2>/dev/null | grep -q unwritten; then
+    echo "✅ FIEMAP报告未写入块"
+else
+    echo "❌ FIEMAP未报告未写入块"
+fi
+
+# 2. KEEP_SIZE不改变文件大小
+echo -e "\n2. KEEP_SIZE..."
+rm -f $F
+echo -n "abc" > $F
+fallocate -k -l 2048 $F
+if [ "$(stat -c %s $F)" -eq 3 ] && [ "$(cat $F)" = "abc" ]; then
+    echo "✅ 文件大小保持不变"
+else
+    echo "❌ KEEP_SIZE改变了文件"
+fi
+
+# 3. 打洞
+echo -e "\n3. PUNCH_HOLE..."
+rm -f $F
+head -c 4096 /dev/urandom > $F
+cp $F /tmp/naive_falloc.bin
+fallocate -p -o 1000 -l 2000 $F
+sync
+echo 3 | sudo tee /proc/sys/vm/drop_caches > /dev/null
+dd if=/dev/zero of=/tmp/naive_falloc.bin bs=1 seek=1000 count=2000 conv=notrunc 2>/dev/null
+if cmp -s $F /tmp/naive_falloc.bin; then
+    echo "✅ 打洞范围读出为0，其余数据不变"
+else
+    echo "❌ 打洞结果错误"
+fi
+
+# 4. 清零范围
+echo -e "\n4. ZERO_RANGE..."
+head -c 4096 /dev/urandom > $F
+cp $F /tmp/naive_falloc.bin
+fallocate -z -o 512 -l 1024 $F
+sync
+echo 3 | sudo tee /proc/sys/vm/drop_caches > /dev/null
+dd if=/dev/zero of=/tmp/naive_falloc.bin bs=512 seek=1 count=2 conv=notrunc 2>/dev/null
+if cmp -s $F /tmp/naive_falloc.bin; then
+    echo "✅ 清零范围正确"
+else
+    echo "❌ 清零结果错误"
+fi
+
+rm -f $F /tmp/naive_falloc.bin
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
@@ -0,0 +1,79 @@
+#!/bin/bash
+
+echo "=== 间接块测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+
+F=/mnt/naive/big.bin
+DEV=$(basename $(grep " /mnt/naive " /proc/mounts | cut -d' ' -f1))
+STATS=/sys/fs/naive/$DEV
+
+# 已分配且未释放的块数
+used_blocks() {
+    echo $(( $(cat $STATS/blocks_allocated) - $(cat $STATS/blocks_freed) ))
+}
+
+# 1. 超过8个直接块：一级间接块（8 + 128块以内）
+echo -e "\n1. 一级间接块..."
+rm -f $F
+head -c 40000 /dev/urandom > /tmp/naive_big.bin
+cp /tmp/naive_big.bin $F
+# 79个数据块 + 1个间接块
+if [ $? -eq 0 ] && [ "$(stat -c %b $F)" -eq 80 ]; then
+    echo "✅ 40000字节写入成功，占用80块（含1个间接块）"
+else
+    echo "❌ 写入失败或块数为 $(stat -c %b $F)"
+fi
+
+# 2. 二级间接块
+echo -e "\n2. 二级间接块..."
+head -c 100000 /dev/urandom > /tmp/naive_big.bin
+cp /tmp/naive_big.bin $F
+sync
+echo 3 | sudo tee /proc/sys/vm/drop_caches > /dev/null
+if cmp -s $F /tmp/naive_big.bin; then
+    echo "✅ 100000字节读回一致"
+else
+    echo "❌ 读回内容不一致"
+fi
+
+# 3. 重新挂载后仍然一致
+echo -e "\n3. 重新挂载..."
+sudo umount /mnt/naive
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+if cmp -s $F /tmp/naive_big.bin; then
+    echo "✅ 重新挂载后内容一致"
+else
+    echo "❌ 重新挂载后内容错误"
+fi
+
+# 4. 间接区中的空洞
+echo -e "\n4. 稀疏大文件..."
+rm -f $F
+dd if=/dev/urandom of=$F bs=512 count=1 seek=1000 2>/dev/null
+if [ "$(stat -c %s $F)" -eq 512512 ] && [ "$(stat -c %b $F)" -eq 3 ]; then
+    echo "✅ 只分配了1个数据块和2个间接块"
+else
+    echo "❌ 稀疏文件占用 $(stat -c %b $F) 块"
+fi
+
+# 5. 截断释放数据块和间接块
+echo -e "\n5. 截断..."
+cp /tmp/naive_big.bin $F
+sync
+before=$(used_blocks)
+truncate -s 1000 $F
+sync
+after=$(used_blocks)
+# 100000字节：196个数据块 + 一级、二级和一个叶子间接块
+if [ "$(stat -c %b $F)" -eq 2 ] && [ $((before - after)) -eq 197 ]; then
+    echo "✅ 截断后只剩2块，间接块一并释放"
+else
+    echo "❌ 截断后占用 $(stat -c %b $F) 块，释放了 $((before - after)) 块"
+fi
+
+rm -f $F /tmp/naive_big.bin
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
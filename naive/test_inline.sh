@@ -0,0 +1,74 @@
+#!/bin/bash
+
+echo "=== 内联数据测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+
+F=/mnt/naive/small.conf
+
+# 1. 小文件不占数据块
+echo -e "\n1. 小文件..."
+echo "key=value" > $F
+if [ "$(stat -c %b $F)" -eq 0 ] && [ "$(cat $F)" = "key=value" ]; then
+    echo "✅ 小文件内容存放在inode中，不占数据块"
+else
+    echo "❌ 小文件占用了 $(stat -c %b $F) 块（需要用新版mkfs.naive格式化）"
+fi
+
+# 2. 重新挂载后内容不变
+echo -e "\n2. 重新挂载..."
+sudo umount /mnt/naive
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+if [ "$(cat $F)" = "key=value" ]; then
+    echo "✅ 内联数据已落盘"
+else
+    echo "❌ 重新挂载后内容错误"
+fi
+
+# 3. 超过内联区后转换为普通文件
+echo -e "\n3. 增长转换..."
+head -c 200 /dev/urandom > $F
+cp $F /tmp/naive_inline.bin
+head -c 1000 /dev/urandom | tee -a /tmp/naive_inline.bin >> $F
+sync
+echo 3 | sudo tee /proc/sys/vm/drop_caches > /dev/null
+if [ "$(stat -c %b $F)" -gt 0 ] && cmp -s $F /tmp/naive_inline.bin; then
+    echo "✅ 追加后转换为普通文件，内容正确"
+else
+    echo "❌ 转换后内容错误"
+fi
+
+# 4. 截断扩大超过内联区
+echo -e "\n4. 截断扩大..."
+printf "abc" > $F
+truncate -s 2000 $F
+if [ "$(head -c 3 $F)" = "abc" ] && [ "$(stat -c %s $F)" -eq 2000 ] &&
+   [ "$(tail -c 1997 $F | tr -d '\0' | wc -c)" -eq 0 ]; then
+    echo "✅ 扩大后前3字节不变，其余为0"
+else
+    echo "❌ 截断扩大结果错误"
+fi
+
+# 5. mmap写内联文件
+echo -e "\n5. mmap写..."
+printf "hello" > $F
+python3 -c "
+import mmap
+with open('$F', 'r+b') as f:
+    m = mmap.mmap(f.fileno(), 5)
+    m[0:5] = b'HELLO'
+    m.close()
+"
+sync
+echo 3 | sudo tee /proc/sys/vm/drop_caches > /dev/null
+if [ "$(cat $F)" = "HELLO" ]; then
+    echo "✅ mmap写入正确"
+else
+    echo "❌ mmap写入结果: $(cat $F)"
+fi
+
+rm -f $F /tmp/naive_inline.bin
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
@@ -0,0 +1,79 @@
+#!/bin/bash
+
+echo "=== 内联目录测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+
+D=/mnt/naive/idir
+
+# 1. 新目录不占数据块
+echo -e "\n1. 新目录..."
+mkdir $D
+if [ "$(stat -c %b $D)" -eq 0 ]; then
+    echo "✅ 新目录不占数据块"
+else
+    echo "❌ 新目录占用了 $(stat -c %b $D) 块（需要用新版mkfs.naive格式化）"
+fi
+
+# 2. 两个目录项仍然内联
+echo -e "\n2. 两个目录项..."
+echo a > $D/a
+echo b > $D/b
+if [ "$(stat -c %b $D)" -eq 0 ]; then
+    echo "✅ 两个目录项存放在inode中"
+else
+    echo "❌ 两个目录项时已分配数据块"
+fi
+
+# 3. 第三个目录项转换为普通目录
+echo -e "\n3. 转换..."
+echo c > $D/c
+if [ "$(stat -c %b $D)" -eq 1 ]; then
+    echo "✅ 写满后转换为一个数据块"
+else
+    echo "❌ 转换后块数为 $(stat -c %b $D)"
+fi
+
+# 4. 重新挂载后所有目录项都能找到，包括根目录中的
+echo -e "\n4. 重新挂载..."
+mkdir $D/sub
+echo s > $D/sub/s
+sudo umount /mnt/naive
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+if [ "$(cat $D/a $D/b $D/c $D/sub/s | tr -d '\n')" = "abcs" ]; then
+    echo "✅ 重新挂载后目录项完整"
+else
+    echo "❌ 重新挂载后找不到目录项"
+fi
+
+# 5. 删除内联目录
+echo -e "\n5. rmdir..."
+rmdir $D/sub 2>/dev/null && echo "❌ 非空的内联目录被删除"
+rm $D/sub/s
+if rmdir $D/sub; then
+    echo "✅ 空的内联目录删除成功"
+else
+    echo "❌ 删除空的内联目录失败"
+fi
+
+# 6. 直接块用完后目录已满，创建失败而不是丢失目录项
+echo -e "\n6. 目录写满..."
+F=/mnt/naive/fulldir
+mkdir $F
+N=0
+while [ $N -lt 30 ] && touch $F/f$N 2>/dev/null; do
+    N=$((N + 1))
+done
+if [ $N -lt 30 ] && [ "$(ls $F | wc -l)" -eq $N ] &&
+   [ "$(stat -c %b $F)" -eq 8 ]; then
+    echo "✅ 目录写满后创建返回错误，已有目录项完整"
+else
+    echo "❌ 目录写满后有 $(ls $F | wc -l) 个目录项，占用 $(stat -c %b $F) 块"
+fi
+rm -rf $F
+
+rm -rf $D
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
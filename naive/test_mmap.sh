@@ -0,0 +1,47 @@
+#!/bin/bash
+
+echo "=== mmap测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+
+# 1. 读映射
+echo -e "\n1. 只读映射..."
+echo -n "Hello mmap" > /mnt/naive/map.txt
+OUT=$(python3 -c '
+import mmap
+with open("/mnt/naive/map.txt", "rb") as f:
+    m = mmap.mmap(f.fileno(), 0, prot=mmap.PROT_READ)
+    print(m[:].decode())
+')
+if [ "$OUT" = "Hello mmap" ]; then
+    echo "✅ 映射读取正确"
+else
+    echo "❌ 映射读取错误: $OUT"
+fi
+
+# 2. 写映射：先扩展文件再通过映射写入，第一次写缺页时分配块
+echo -e "\n2. 共享写映射..."
+rm -f /mnt/naive/map.bin
+python3 -c '
+import mmap, os
+fd = os.open("/mnt/naive/map.bin", os.O_RDWR | os.O_CREAT)
+os.ftruncate(fd, 2048)
+m = mmap.mmap(fd, 2048)
+m[1000:1010] = b"0123456789"
+m.flush()
+m.close()
+os.close(fd)
+'
+sync
+echo 3 | sudo tee /proc/sys/vm/drop_caches > /dev/null
+if [ "$(dd if=/mnt/naive/map.bin bs=1 skip=1000 count=10 2>/dev/null)" = "0123456789" ]; then
+    echo "✅ 映射写入已落盘"
+else
+    echo "❌ 映射写入丢失"
+fi
+
+rm -f /mnt/naive/map.txt /mnt/naive/map.bin
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
@@ -0,0 +1,64 @@
+#!/bin/bash
+
+echo "=== 挂载选项测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+
+# 1. 带选项挂载
+echo -e "\n1. 带选项挂载..."
+sudo mount -t naive -o loop,commit=2,alloc=next,ra=16,icache=64,atime=strict,debug=1 tmpfile /mnt/naive
+if [ $? -ne 0 ]; then
+    echo "❌ 挂载失败"
+    sudo dmesg | tail -10
+    exit 1
+fi
+
+# 2. 检查/proc/mounts
+echo -e "\n2. 检查/proc/mounts..."
+OPTS=$(grep " /mnt/naive " /proc/mounts)
+echo "$OPTS"
+for opt in commit=2 alloc=next ra=16 icache=64 atime=strict debug=1; do
+    if echo "$OPTS" | grep -q "$opt"; then
+        echo "✅ $opt"
+    else
+        echo "❌ $opt 未显示"
+    fi
+done
+
+# 3. remount只修改部分选项
+echo -e "\n3. remount..."
+sudo mount -o remount,commit=10 /mnt/naive
+if grep " /mnt/naive " /proc/mounts | grep -q "commit=10.*alloc=next"; then
+    echo "✅ remount后其余选项保持不变"
+else
+    echo "❌ remount选项错误"
+fi
+
+# 4. 只读与读写之间remount
+echo -e "\n4. remount只读/读写..."
+echo data > /mnt/naive/ro_test
+sudo mount -o remount,ro /mnt/naive
+if ! echo more >> /mnt/naive/ro_test 2>/dev/null && [ "$(cat /mnt/naive/ro_test)" = "data" ]; then
+    echo "✅ 只读后拒绝写入，数据已写出"
+else
+    echo "❌ 只读remount后仍可写"
+fi
+sudo mount -o remount,rw /mnt/naive
+if echo more >> /mnt/naive/ro_test && rm /mnt/naive/ro_test; then
+    echo "✅ 恢复读写"
+else
+    echo "❌ remount读写失败"
+fi
+
+# 5. 非法选项应被拒绝
+echo -e "\n5. 非法选项..."
+sudo umount /mnt/naive
+if sudo mount -t naive -o loop,alloc=best tmpfile /mnt/naive 2>/dev/null; then
+    echo "❌ 非法选项被接受"
+    sudo umount /mnt/naive
+else
+    echo "✅ 非法选项被拒绝"
+fi
+
+echo -e "\n=== 测试完成 ==="
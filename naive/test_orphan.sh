@@ -0,0 +1,74 @@
+#!/bin/bash
+
+echo "=== 孤儿inode测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+
+F=/mnt/naive/orphan
+DEV=$(basename $(findmnt -n -o SOURCE /mnt/naive))
+S=/sys/fs/naive/$DEV
+
+# 1. 删除仍被打开的文件，块在关闭之前不释放
+echo -e "\n1. 删除打开的文件..."
+dd if=/dev/urandom of=$F bs=4k count=8 2>/dev/null
+SUM=$(md5sum < $F)
+exec 3<$F
+FREED=$(cat $S/blocks_freed)
+rm $F
+if [ "$(cat $S/blocks_freed)" -eq "$FREED" ] && [ "$(md5sum <&3)" = "$SUM" ]; then
+    echo "✅ 删除后仍可从打开的文件读出原内容"
+else
+    echo "❌ 文件仍被打开时块已被释放"
+fi
+
+# 2. 模拟崩溃：文件仍被打开时复制镜像，挂载副本时释放孤儿inode
+echo -e "\n2. 崩溃后挂载..."
+sync
+cp tmpfile tmpfile.crash
+sudo mkdir -p /mnt/naive2
+sudo mount -t naive -o loop tmpfile.crash /mnt/naive2 || exit 1
+DEV2=$(basename $(findmnt -n -o SOURCE /mnt/naive2))
+if [ "$(cat /sys/fs/naive/$DEV2/blocks_freed)" -ge 64 ] &&
+   sudo dmesg | tail -5 | grep -q "orphan"; then
+    echo "✅ 挂载时释放了孤儿inode的块"
+else
+    echo "❌ 挂载时没有处理孤儿链表"
+fi
+sudo umount /mnt/naive2
+rm -f tmpfile.crash
+
+# 3. 崩溃后先只读挂载再remount读写，超过reclaim阈值的孤儿也要在remount时释放
+echo -e "\n3. 只读挂载后remount读写..."
+G=/mnt/naive/orphan_big
+dd if=/dev/urandom of=$G bs=4k count=64 2>/dev/null
+exec 4<$G
+rm $G
+sync
+cp tmpfile tmpfile.crash
+sudo mount -t naive -o loop,ro tmpfile.crash /mnt/naive2 || exit 1
+DEV2=$(basename $(findmnt -n -o SOURCE /mnt/naive2))
+sudo mount -o remount,rw /mnt/naive2
+if [ "$(cat /sys/fs/naive/$DEV2/blocks_freed)" -ge 576 ] &&
+   ! sudo dmesg | tail -5 | grep -q "bad orphan list"; then
+    echo "✅ remount读写时释放了全部孤儿inode"
+else
+    echo "❌ remount读写时孤儿链表处理错误"
+fi
+sudo umount /mnt/naive2
+rm -f tmpfile.crash
+exec 4<&-
+
+# 4. 关闭文件后释放块
+echo -e "\n4. 关闭..."
+exec 3<&-
+sleep 1
+if [ "$(( $(cat $S/blocks_freed) - FREED ))" -ge 64 ]; then
+    echo "✅ 关闭后释放了 $(( $(cat $S/blocks_freed) - FREED )) 个块"
+else
+    echo "❌ 关闭后块没有释放"
+fi
+
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
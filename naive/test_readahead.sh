@@ -0,0 +1,52 @@
+#!/bin/bash
+
+echo "=== 自适应预读测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop,ra=64 tmpfile /mnt/naive || exit 1
+
+DEV=$(basename $(grep " /mnt/naive " /proc/mounts | cut -d' ' -f1))
+STATS=/sys/fs/naive/$DEV
+
+dd if=/dev/urandom of=/mnt/naive/ra.bin bs=512 count=8 2>/dev/null
+sync
+echo 3 | sudo tee /proc/sys/vm/drop_caches > /dev/null
+
+# 1. 顺序读
+echo -e "\n1. 顺序读..."
+SEQ0=$(cat $STATS/ra_sequential)
+dd if=/mnt/naive/ra.bin of=/dev/null bs=512 count=8 2>/dev/null
+SEQ1=$(cat $STATS/ra_sequential)
+if [ $((SEQ1 - SEQ0)) -ge 7 ]; then
+    echo "✅ 顺序读被识别 ($((SEQ1 - SEQ0))次)"
+else
+    echo "❌ 顺序读未被识别 ($((SEQ1 - SEQ0))次)"
+fi
+
+# 2. 随机读
+echo -e "\n2. 随机读..."
+RND0=$(cat $STATS/ra_random)
+for blk in 5 1 7 3; do
+    dd if=/mnt/naive/ra.bin of=/dev/null bs=512 count=1 skip=$blk 2>/dev/null
+done
+RND1=$(cat $STATS/ra_random)
+if [ $((RND1 - RND0)) -ge 3 ]; then
+    echo "✅ 随机读被识别 ($((RND1 - RND0))次)"
+else
+    echo "❌ 随机读未被识别 ($((RND1 - RND0))次)"
+fi
+
+# 3. 预读上限
+echo -e "\n3. ra上限..."
+sudo umount /mnt/naive
+if sudo mount -t naive -o loop,ra=100000 tmpfile /mnt/naive 2>/dev/null; then
+    echo "❌ 超出上限的ra被接受"
+    sudo umount /mnt/naive
+else
+    echo "✅ 超出上限的ra被拒绝"
+fi
+
+sudo mount -t naive -o loop tmpfile /mnt/naive && rm -f /mnt/naive/ra.bin
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
@@ -0,0 +1,55 @@
+#!/bin/bash
+
+echo "=== 后台回收测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop,reclaim=128 tmpfile /mnt/naive || exit 1
+
+F=/mnt/naive/big
+DEV=$(basename $(findmnt -n -o SOURCE /mnt/naive))
+S=/sys/fs/naive/$DEV
+
+# 1. 选项显示在/proc/mounts中
+echo -e "\n1. 挂载选项..."
+if grep -q "reclaim=128" /proc/mounts; then
+    echo "✅ reclaim=128"
+else
+    echo "❌ /proc/mounts中没有reclaim选项"
+fi
+
+# 2. 删除大文件后块由后台释放
+echo -e "\n2. 删除大文件..."
+dd if=/dev/zero of=$F bs=4k count=25 2>/dev/null
+sync
+FREED=$(cat $S/blocks_freed)
+rm $F
+sleep 1
+if [ "$(( $(cat $S/blocks_freed) - FREED ))" -ge 200 ]; then
+    echo "✅ 后台释放了 $(( $(cat $S/blocks_freed) - FREED )) 个块"
+else
+    echo "❌ 删除后只释放了 $(( $(cat $S/blocks_freed) - FREED )) 个块"
+fi
+
+# 3. 释放的空间可以重新使用
+echo -e "\n3. 重新写入..."
+if dd if=/dev/zero of=$F bs=4k count=25 2>/dev/null; then
+    echo "✅ 空间已归还"
+else
+    echo "❌ 写入失败，空间没有归还"
+fi
+
+# 4. 删除后立即卸载，卸载等待回收完成
+echo -e "\n4. 删除后立即卸载..."
+rm $F
+sudo umount /mnt/naive || exit 1
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+if dd if=/dev/zero of=$F bs=4k count=25 2>/dev/null; then
+    echo "✅ 重新挂载后空间完整"
+else
+    echo "❌ 重新挂载后空间丢失"
+fi
+
+rm -f $F
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
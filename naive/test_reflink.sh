@@ -0,0 +1,58 @@
+#!/bin/bash
+
+echo "=== reflink测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+
+DEV=$(basename $(grep " /mnt/naive " /proc/mounts | cut -d' ' -f1))
+STATS=/sys/fs/naive/$DEV
+
+dd if=/dev/urandom of=/mnt/naive/orig.bin bs=512 count=6 2>/dev/null
+cp /mnt/naive/orig.bin /tmp/naive_orig.bin
+sync
+
+# 1. 克隆不分配数据块
+echo -e "\n1. FICLONE..."
+A0=$(cat $STATS/blocks_allocated)
+if ! cp --reflink=always /mnt/naive/orig.bin /mnt/naive/clone.bin; then
+    echo "❌ FICLONE失败（需要用新版mkfs.naive格式化）"
+    sudo umount /mnt/naive
+    exit 1
+fi
+sync
+A1=$(cat $STATS/blocks_allocated)
+if [ "$A0" -eq "$A1" ] && cmp -s /mnt/naive/orig.bin /mnt/naive/clone.bin; then
+    echo "✅ 克隆内容一致且未分配新块"
+else
+    echo "❌ 克隆分配了 $((A1 - A0)) 个块"
+fi
+
+# 2. 写克隆文件触发写时复制，原文件不变
+echo -e "\n2. 写时复制..."
+printf 'COW!' | dd of=/mnt/naive/clone.bin bs=1 seek=700 conv=notrunc 2>/dev/null
+sync
+echo 3 | sudo tee /proc/sys/vm/drop_caches > /dev/null
+A2=$(cat $STATS/blocks_allocated)
+if cmp -s /mnt/naive/orig.bin /tmp/naive_orig.bin && \
+   [ "$(dd if=/mnt/naive/clone.bin bs=1 skip=700 count=4 2>/dev/null)" = "COW!" ]; then
+    echo "✅ 原文件未受影响，复制了 $((A2 - A1)) 个块"
+else
+    echo "❌ 写时复制错误"
+fi
+
+# 3. 删除原文件后克隆仍可读
+echo -e "\n3. 删除原文件..."
+rm /mnt/naive/orig.bin
+sync
+echo 3 | sudo tee /proc/sys/vm/drop_caches > /dev/null
+if cmp -s <(head -c 512 /mnt/naive/clone.bin) <(head -c 512 /tmp/naive_orig.bin); then
+    echo "✅ 共享块未被提前释放"
+else
+    echo "❌ 克隆数据损坏"
+fi
+
+rm -f /mnt/naive/clone.bin /tmp/naive_orig.bin
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
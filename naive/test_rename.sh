@@ -0,0 +1,85 @@
+#!/bin/bash
+
+echo "=== 硬链接与重命名测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+
+D=/mnt/naive/rdir
+DEV=$(basename $(findmnt -n -o SOURCE /mnt/naive))
+S=/sys/fs/naive/$DEV
+mkdir -p $D
+
+# 1. 硬链接共享同一inode
+echo -e "\n1. 硬链接..."
+echo hello > $D/a
+ln $D/a $D/b
+if [ "$(stat -c %i $D/a)" = "$(stat -c %i $D/b)" ] && [ "$(stat -c %h $D/a)" -eq 2 ]; then
+    echo "✅ 两个名字指向同一inode，链接数为2"
+else
+    echo "❌ 硬链接的inode或链接数不对"
+fi
+
+# 2. 删除一个链接后数据仍在
+echo -e "\n2. 删除一个链接..."
+rm $D/a
+if [ "$(cat $D/b)" = "hello" ] && [ "$(stat -c %h $D/b)" -eq 1 ]; then
+    echo "✅ 另一个链接的数据完好"
+else
+    echo "❌ 删除一个链接后数据丢失"
+fi
+
+# 3. 原子替换：写临时文件后重命名覆盖目标，不复制数据
+echo -e "\n3. 重命名覆盖..."
+dd if=/dev/urandom of=$D/tmp bs=4k count=8 2>/dev/null
+cp $D/tmp /tmp/naive_rename_expect
+INO=$(stat -c %i $D/tmp)
+ALLOC=$(cat $S/blocks_allocated)
+mv -f $D/tmp $D/b
+if [ "$(stat -c %i $D/b)" = "$INO" ] && [ "$(cat $S/blocks_allocated)" -eq "$ALLOC" ] &&
+   cmp -s $D/b /tmp/naive_rename_expect && [ ! -e $D/tmp ]; then
+    echo "✅ 目标被替换为源inode，没有分配新块"
+else
+    echo "❌ 重命名覆盖结果不对"
+fi
+
+# 4. RENAME_NOREPLACE
+echo -e "\n4. 不覆盖..."
+echo x > $D/x
+mv -n $D/x $D/b 2>/dev/null
+if [ -e $D/x ] && cmp -s $D/b /tmp/naive_rename_expect; then
+    echo "✅ 目标存在时没有覆盖"
+else
+    echo "❌ 目标被覆盖"
+fi
+
+# 5. RENAME_EXCHANGE
+echo -e "\n5. 交换..."
+if mv --exchange $D/x $D/b 2>/dev/null; then
+    if [ "$(cat $D/b)" = "x" ] && cmp -s $D/x /tmp/naive_rename_expect; then
+        echo "✅ 两个目录项交换成功"
+    else
+        echo "❌ 交换后内容不对"
+    fi
+else
+    echo "mv不支持--exchange（需要coreutils 9.5以上），跳过"
+fi
+
+# 6. 跨目录移动目录，链接数随之更新，重新挂载后仍可见
+echo -e "\n6. 移动目录..."
+mkdir $D/p1 $D/p2 $D/p1/sub
+echo s > $D/p1/sub/s
+mv $D/p1/sub $D/p2/
+sudo umount /mnt/naive
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+if [ "$(cat $D/p2/sub/s)" = "s" ] && [ ! -e $D/p1/sub ] &&
+   [ "$(stat -c %h $D/p1)" -eq 2 ] && [ "$(stat -c %h $D/p2)" -eq 3 ]; then
+    echo "✅ 目录移动后链接数正确，重新挂载后可见"
+else
+    echo "❌ 目录移动后状态不对"
+fi
+
+rm -rf $D /tmp/naive_rename_expect
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
@@ -0,0 +1,72 @@
+#!/bin/bash
+
+echo "=== 在线扩容测试 ==="
+
+cd ~/filesystem_lab/naive
+gcc -O2 -o resize.naive resize.naive.c || exit 1
+sudo umount /mnt/naive 2>/dev/null
+
+# 在单独的镜像上测试，不改动tmpfile
+IMG=/tmp/naive_resize.img
+rm -f $IMG
+truncate -s 1M $IMG
+./mkfs.naive $IMG > /dev/null || exit 1
+LOOP=$(sudo losetup -f --show $IMG) || exit 1
+sudo mount -t naive $LOOP /mnt/naive || exit 1
+
+# 1. 扩容前写满
+echo -e "\n1. 扩容前写满..."
+head -c 100K /dev/urandom > /tmp/naive_keep
+cp /tmp/naive_keep /mnt/naive/keep
+if ! dd if=/dev/zero of=/mnt/naive/fill bs=4k count=1024 2>/dev/null; then
+    echo "✅ 1MB镜像已写满"
+else
+    echo "❌ 1MB镜像写入了4MB"
+fi
+rm -f /mnt/naive/fill
+
+# 2. 在线扩容到8MB（需要多个块位图块）
+echo -e "\n2. 扩容..."
+truncate -s 8M $IMG
+sudo losetup -c $LOOP
+if sudo ./resize.naive /mnt/naive; then
+    echo "✅ resize成功"
+else
+    echo "❌ resize失败"
+fi
+
+# 3. 新增的空间可用，原有数据不变
+echo -e "\n3. 写入新空间..."
+if dd if=/dev/zero of=/mnt/naive/fill bs=4k count=1024 2>/dev/null; then
+    echo "✅ 写入4MB成功"
+else
+    echo "❌ 扩容后仍然写不下"
+fi
+cmp -s /tmp/naive_keep /mnt/naive/keep && echo "✅ 原有数据不变" || echo "❌ 原有数据改变"
+
+# 4. 重新挂载后布局正确
+echo -e "\n4. 重新挂载..."
+sudo umount /mnt/naive
+sudo mount -t naive $LOOP /mnt/naive || exit 1
+if [ "$(stat -c %s /mnt/naive/fill)" = "4194304" ] && cmp -s /tmp/naive_keep /mnt/naive/keep; then
+    echo "✅ 重新挂载后数据完整"
+else
+    echo "❌ 重新挂载后数据丢失"
+fi
+
+# 5. 再扩一次，并拒绝缩小
+echo -e "\n5. 再次扩容..."
+truncate -s 16M $IMG
+sudo losetup -c $LOOP
+sudo ./resize.naive /mnt/naive 16M && echo "✅ 第二次扩容成功" || echo "❌ 第二次扩容失败"
+if sudo ./resize.naive /mnt/naive 4M 2>/dev/null; then
+    echo "❌ 缩小被接受"
+else
+    echo "✅ 拒绝缩小"
+fi
+
+rm -f /mnt/naive/fill /mnt/naive/keep /tmp/naive_keep
+sudo umount /mnt/naive
+sudo losetup -d $LOOP
+rm -f $IMG
+echo -e "\n=== 测试完成 ==="
@@ -0,0 +1,57 @@
+#!/bin/bash
+
+echo "=== 稀疏文件测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+
+F=/mnt/naive/sparse.bin
+rm -f $F
+
+# 1. 跳过中间的块写入，只分配实际写入的块
+echo -e "\n1. 创建稀疏文件..."
+printf 'HEAD' | dd of=$F bs=1 2>/dev/null
+printf 'TAIL' | dd of=$F bs=512 seek=7 2>/dev/null
+sync
+BLOCKS=$(stat -c %b $F)
+if [ "$BLOCKS" -eq 2 ]; then
+    echo "✅ 只分配了2个块"
+else
+    echo "❌ 分配了 $BLOCKS 个块"
+fi
+
+# 2. 空洞读出为0
+echo -e "\n2. 读空洞..."
+echo 3 | sudo tee /proc/sys/vm/drop_caches > /dev/null
+if cmp -s <(dd if=$F bs=512 skip=1 count=6 2>/dev/null) <(head -c 3072 /dev/zero); then
+    echo "✅ 空洞读出为0"
+else
+    echo "❌ 空洞内容错误"
+fi
+
+# 3. SEEK_DATA/SEEK_HOLE
+echo -e "\n3. SEEK_DATA/SEEK_HOLE..."
+OUT=$(python3 -c '
+import os
+fd = os.open("/mnt/naive/sparse.bin", os.O_RDONLY)
+print(os.lseek(fd, 0, os.SEEK_HOLE), os.lseek(fd, 512, os.SEEK_DATA))
+')
+if [ "$OUT" = "512 3584" ]; then
+    echo "✅ 空洞从512开始，数据从3584开始"
+else
+    echo "❌ lseek结果: $OUT"
+fi
+
+# 4. FIEMAP只报告两个区段
+echo -e "\n4. FIEMAP..."
+filefrag -v $F
+if [ "$(filefrag $F | grep -o '[0-9]* extent' | cut -d' ' -f1)" -eq 2 ]; then
+    echo "✅ 两个区段"
+else
+    echo "❌ 区段数错误"
+fi
+
+rm -f $F
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
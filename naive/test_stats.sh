@@ -0,0 +1,36 @@
+#!/bin/bash
+
+echo "=== 性能计数器测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+
+DEV=$(basename $(grep " /mnt/naive " /proc/mounts | cut -d' ' -f1))
+STATS=/sys/fs/naive/$DEV
+echo "计数器目录: $STATS"
+if [ ! -d "$STATS" ]; then
+    echo "❌ $STATS 不存在"
+    exit 1
+fi
+
+# 产生一些读写和查找
+echo "Hello Stats" > /mnt/naive/stats.txt
+cat /mnt/naive/stats.txt > /dev/null
+ls /mnt/naive/no_such_file 2>/dev/null
+
+for f in blocks_allocated bytes_written bytes_read lookup_misses; do
+    v=$(cat $STATS/$f)
+    if [ "$v" -gt 0 ]; then
+        echo "✅ $f = $v"
+    else
+        echo "❌ $f = $v"
+    fi
+done
+
+echo -e "\n读延迟直方图:"
+cat $STATS/read_latency
+
+rm /mnt/naive/stats.txt
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
@@ -0,0 +1,57 @@
+#!/bin/bash
+
+echo "=== 符号链接测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+
+D=/mnt/naive/sdir
+mkdir -p $D
+echo target > $D/file
+LONG=$(printf 'x%.0s' $(seq 1 600))
+
+# 1. 短目标为快速符号链接，不占数据块
+echo -e "\n1. 快速符号链接..."
+ln -s file $D/short
+if [ "$(readlink $D/short)" = "file" ] && [ "$(stat -c %b $D/short)" -eq 0 ] &&
+   [ "$(cat $D/short)" = "target" ]; then
+    echo "✅ 目标存放在inode中，不占数据块"
+else
+    echo "❌ 快速符号链接不对（块数 $(stat -c %b $D/short)）"
+fi
+
+# 2. 长目标存放在数据块中
+echo -e "\n2. 长符号链接..."
+ln -s $LONG $D/long
+if [ "$(readlink $D/long)" = "$LONG" ] && [ "$(stat -c %s $D/long)" -eq 600 ] &&
+   [ "$(stat -c %b $D/long)" -eq 2 ]; then
+    echo "✅ 600字节的目标占用2个数据块"
+else
+    echo "❌ 长符号链接不对（块数 $(stat -c %b $D/long)）"
+fi
+
+# 3. 重新挂载后两种符号链接都能读出
+echo -e "\n3. 重新挂载..."
+sudo umount /mnt/naive
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+if [ "$(readlink $D/short)" = "file" ] && [ "$(readlink $D/long)" = "$LONG" ]; then
+    echo "✅ 重新挂载后目标完整"
+else
+    echo "❌ 重新挂载后目标不对"
+fi
+
+# 4. 删除长符号链接释放数据块
+echo -e "\n4. 删除..."
+DEV=$(basename $(findmnt -n -o SOURCE /mnt/naive))
+FREED=$(cat /sys/fs/naive/$DEV/blocks_freed)
+rm $D/long $D/short
+if [ "$(( $(cat /sys/fs/naive/$DEV/blocks_freed) - FREED ))" -eq 2 ]; then
+    echo "✅ 删除后释放了2个块"
+else
+    echo "❌ 删除后释放的块数不对"
+fi
+
+rm -rf $D
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
@@ -0,0 +1,83 @@
+#!/bin/bash
+
+echo "=== 截断测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+
+F=/mnt/naive/trunc.bin
+DEV=$(basename $(grep " /mnt/naive " /proc/mounts | cut -d' ' -f1))
+STATS=/sys/fs/naive/$DEV
+
+# 已分配且未释放的块数
+used_blocks() {
+    echo $(( $(cat $STATS/blocks_allocated) - $(cat $STATS/blocks_freed) ))
+}
+
+# 1. 缩小后释放尾部的块
+echo -e "\n1. ftruncate缩小..."
+rm -f $F
+head -c 4096 /dev/urandom > $F
+sync
+before=$(used_blocks)
+truncate -s 700 $F
+sync
+after=$(used_blocks)
+if [ "$(stat -c %s $F)" -eq 700 ] && [ "$(stat -c %b $F)" -eq 2 ]; then
+    echo "✅ 大小为700，占用2块"
+else
+    echo "❌ 截断后大小或块数错误"
+fi
+if [ "$after" -lt "$before" ]; then
+    echo "✅ 空闲空间增加 ($before -> $after)"
+else
+    echo "❌ 块没有归还分配器"
+fi
+
+# 2. 再扩大时旧末尾之后读出为0
+echo -e "\n2. 缩小后扩大..."
+head -c 700 $F > /tmp/naive_trunc.bin
+truncate -s 4096 $F
+sync
+echo 3 | sudo tee /proc/sys/vm/drop_caches > /dev/null
+truncate -s 4096 /tmp/naive_trunc.bin
+if cmp -s $F /tmp/naive_trunc.bin; then
+    echo "✅ 扩大部分读出为0"
+else
+    echo "❌ 扩大部分读到了旧数据"
+fi
+
+# 3. O_TRUNC重写文件不泄漏空间
+echo -e "\n3. O_TRUNC反复重写..."
+rm -f $F
+sync
+before=$(used_blocks)
+for i in $(seq 1 20); do
+    head -c 4096 /dev/urandom > $F
+done
+rm -f $F
+sync
+after=$(used_blocks)
+if [ "$after" -eq "$before" ]; then
+    echo "✅ 重写20次后空间全部归还"
+else
+    echo "❌ 空间泄漏 ($before -> $after)"
+fi
+
+# 4. 截断后重新挂载
+echo -e "\n4. 重新挂载..."
+head -c 4096 /dev/urandom > $F
+truncate -s 1000 $F
+head -c 1000 $F > /tmp/naive_trunc.bin
+sudo umount /mnt/naive
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+if [ "$(stat -c %s $F)" -eq 1000 ] && cmp -s $F /tmp/naive_trunc.bin; then
+    echo "✅ 重新挂载后大小和内容正确"
+else
+    echo "❌ 重新挂载后结果错误"
+fi
+
+rm -f $F /tmp/naive_trunc.bin
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
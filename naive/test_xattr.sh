@@ -0,0 +1,72 @@
+#!/bin/bash
+
+echo "=== 扩展属性测试 ==="
+
+cd ~/filesystem_lab/naive
+sudo umount /mnt/naive 2>/dev/null
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+
+D=/mnt/naive/xdir
+DEV=$(basename $(findmnt -n -o SOURCE /mnt/naive))
+S=/sys/fs/naive/$DEV
+mkdir -p $D
+touch $D/a $D/b $D/c
+BIG=$(printf 'v%.0s' $(seq 1 200))
+
+# 1. 小属性存放在inode内，不占数据块
+echo -e "\n1. inode内的扩展属性..."
+setfattr -n user.tag -v small $D/a
+if [ "$(getfattr --only-values -n user.tag $D/a 2>/dev/null)" = "small" ] &&
+   [ "$(stat -c %b $D/a)" -eq 0 ]; then
+    echo "✅ 小属性存放在inode内"
+else
+    echo "❌ 小属性读写不对（需要用新版mkfs.naive格式化）"
+fi
+
+# 2. 大属性放进扩展属性块，内容相同的块被共享
+echo -e "\n2. 共享扩展属性块..."
+ALLOC=$(cat $S/blocks_allocated)
+setfattr -n user.big -v $BIG $D/b
+setfattr -n user.big -v $BIG $D/c
+if [ "$(( $(cat $S/blocks_allocated) - ALLOC ))" -eq 1 ] &&
+   [ "$(getfattr --only-values -n user.big $D/c 2>/dev/null)" = "$BIG" ]; then
+    echo "✅ 两个文件共享一个扩展属性块"
+else
+    echo "❌ 分配了 $(( $(cat $S/blocks_allocated) - ALLOC )) 个扩展属性块"
+fi
+
+# 3. 修改共享块中的属性不影响另一个文件
+echo -e "\n3. 修改共享的属性..."
+setfattr -n user.big -v other$BIG $D/c
+if [ "$(getfattr --only-values -n user.big $D/b 2>/dev/null)" = "$BIG" ]; then
+    echo "✅ 另一个文件的属性不变"
+else
+    echo "❌ 修改影响了共享块的其他引用者"
+fi
+
+# 4. 列出和删除，重新挂载后仍然存在
+echo -e "\n4. 重新挂载..."
+setfattr -x user.tag $D/a
+sudo umount /mnt/naive
+sudo mount -t naive -o loop tmpfile /mnt/naive || exit 1
+if [ -z "$(getfattr -d $D/a 2>/dev/null)" ] &&
+   getfattr -d $D/b 2>/dev/null | grep -q "user.big" &&
+   [ "$(getfattr --only-values -n user.big $D/c 2>/dev/null)" = "other$BIG" ]; then
+    echo "✅ 重新挂载后属性完整"
+else
+    echo "❌ 重新挂载后属性不对"
+fi
+
+# 5. 删除文件释放扩展属性块
+echo -e "\n5. 删除..."
+FREED=$(cat $S/blocks_freed)
+rm $D/b $D/c
+if [ "$(( $(cat $S/blocks_freed) - FREED ))" -eq 2 ]; then
+    echo "✅ 两个扩展属性块都已释放"
+else
+    echo "❌ 释放了 $(( $(cat $S/blocks_freed) - FREED )) 个块"
+fi
+
+rm -rf $D
+sudo umount /mnt/naive
+echo -e "\n=== 测试完成 ==="
@@ -0,0 +1,153 @@
+/* naivefs跟踪点，通过ftrace/perf按需启用，关闭时几乎没有开销 */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM naivefs
+
+#if !defined(_TRACE_NAIVEFS_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_NAIVEFS_H
+
+#include <linux/tracepoint.h>
+#include <linux/fs.h>
+
+/* 文件读写 */
+DECLARE_EVENT_CLASS(naivefs_rw_class,
+    TP_PROTO(struct inode *inode, loff_t pos, size_t len, ssize_t ret),
+    TP_ARGS(inode, pos, len, ret),
+
+    TP_STRUCT__entry(
+        __field(dev_t,          dev)
+        __field(unsigned long,  ino)
+        __field(loff_t,         size)
+        __field(loff_t,         pos)
+        __field(size_t,         len)
+        __field(ssize_t,        ret)
+    ),
+
+    TP_fast_assign(
+        __entry->dev    = inode->i_sb->s_dev;
+        __entry->ino    = inode->i_ino;
+        __entry->size   = i_size_read(inode);
+        __entry->pos    = pos;
+        __entry->len    = len;
+        __entry->ret    = ret;
+    ),
+
+    TP_printk("dev %d,%d ino %lu size %lld pos %lld len %zu ret %zd",
+              MAJOR(__entry->dev), MINOR(__entry->dev), __entry->ino,
+              __entry->size, __entry->pos, __entry->len, __entry->ret)
+);
+
+DEFINE_EVENT(naivefs_rw_class, naivefs_file_read,
+    TP_PROTO(struct inode *inode, loff_t pos, size_t len, ssize_t ret),
+    TP_ARGS(inode, pos, len, ret)
+);
+
+DEFINE_EVENT(naivefs_rw_class, naivefs_file_write,
+    TP_PROTO(struct inode *inode, loff_t pos, size_t len, ssize_t ret),
+    TP_ARGS(inode, pos, len, ret)
+);
+
+/* 数据块分配与释放，count为从block开始的连续块数 */
+DECLARE_EVENT_CLASS(naivefs_block_class,
+    TP_PROTO(struct super_block *sb, unsigned long block, unsigned int count),
+    TP_ARGS(sb, block, count),
+
+    TP_STRUCT__entry(
+        __field(dev_t,          dev)
+        __field(unsigned long,  block)
+        __field(unsigned int,   count)
+    ),
+
+    TP_fast_assign(
+        __entry->dev    = sb->s_dev;
+        __entry->block  = block;
+        __entry->count  = count;
+    ),
+
+    TP_printk("dev %d,%d block %lu count %u",
+              MAJOR(__entry->dev), MINOR(__entry->dev), __entry->block,
+              __entry->count)
+);
+
+DEFINE_EVENT(naivefs_block_class, naivefs_alloc_block,
+    TP_PROTO(struct super_block *sb, unsigned long block, unsigned int count),
+    TP_ARGS(sb, block, count)
+);
+
+DEFINE_EVENT(naivefs_block_class, naivefs_free_block,
+    TP_PROTO(struct super_block *sb, unsigned long block, unsigned int count),
+    TP_ARGS(sb, block, count)
+);
+
+/* 目录查找与目录项增删，ino为0表示未找到 */
+DECLARE_EVENT_CLASS(naivefs_dirent_class,
+    TP_PROTO(struct inode *dir, struct dentry *dentry, unsigned long ino),
+    TP_ARGS(dir, dentry, ino),
+
+    TP_STRUCT__entry(
+        __field(dev_t,          dev)
+        __field(unsigned long,  dir)
+        __field(unsigned long,  ino)
+        __string(name,          dentry->d_name.name)
+    ),
+
+    TP_fast_assign(
+        __entry->dev    = dir->i_sb->s_dev;
+        __entry->dir    = dir->i_ino;
+        __entry->ino    = ino;
+        __assign_str(name);
+    ),
+
+    TP_printk("dev %d,%d dir %lu name %s ino %lu",
+              MAJOR(__entry->dev), MINOR(__entry->dev), __entry->dir,
+              __get_str(name), __entry->ino)
+);
+
+DEFINE_EVENT(naivefs_dirent_class, naivefs_lookup,
+    TP_PROTO(struct inode *dir, struct dentry *dentry, unsigned long ino),
+    TP_ARGS(dir, dentry, ino)
+);
+
+DEFINE_EVENT(naivefs_dirent_class, naivefs_add_entry,
+    TP_PROTO(struct inode *dir, struct dentry *dentry, unsigned long ino),
+    TP_ARGS(dir, dentry, ino)
+);
+
+DEFINE_EVENT(naivefs_dirent_class, naivefs_remove_entry,
+    TP_PROTO(struct inode *dir, struct dentry *dentry, unsigned long ino),
+    TP_ARGS(dir, dentry, ino)
+);
+
+/* inode回写 */
+TRACE_EVENT(naivefs_write_inode,
+    TP_PROTO(struct inode *inode, int ret),
+    TP_ARGS(inode, ret),
+
+    TP_STRUCT__entry(
+        __field(dev_t,          dev)
+        __field(unsigned long,  ino)
+        __field(loff_t,         size)
+        __field(unsigned int,   nlink)
+        __field(int,            ret)
+    ),
+
+    TP_fast_assign(
+        __entry->dev    = inode->i_sb->s_dev;
+        __entry->ino    = inode->i_ino;
+        __entry->size   = i_size_read(inode);
+        __entry->nlink  = inode->i_nlink;
+        __entry->ret    = ret;
+    ),
+
+    TP_printk("dev %d,%d ino %lu size %lld nlink %u ret %d",
+              MAJOR(__entry->dev), MINOR(__entry->dev), __entry->ino,
+              __entry->size, __entry->nlink, __entry->ret)
+);
+
+#endif /* _TRACE_NAIVEFS_H */
+
+/* 模块外编译：头文件位于$(src)/trace/events下 */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH trace/events
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE naivefs
+#include <trace/define_trace.h>